@@ -0,0 +1,86 @@
+/***************************************************************************************
+    File: arena.h
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    MereTDD per-test arena, kept apart from test.h so only the tests
+    that use it pay for <memory_resource>
+ **************************************************************************************/
+#pragma once
+
+#include "test.h"
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace MereTDD
+{
+	// A monotonic arena that lives for one test. Deallocation does
+	// nothing and the runner drops every allocation at once after
+	// run_ex() returns, so nodes of large temporary structures cost a
+	// pointer bump to build and nothing to tear down. Only test bodies
+	// and SetupAndTeardown fixtures may use it.
+	class TestArena : public std::pmr::memory_resource
+	{
+	public:
+		TestArena();
+
+		TestArena(TestArena const&) = delete;
+
+		TestArena& operator=(TestArena const&) = delete;
+
+		ArenaUsage const& usage() const
+		{
+			return m_usage;
+		}
+
+		// Releases everything and keeps the first block for the next
+		// test, so tests that fit in it never touch the heap.
+		void reset();
+
+	private:
+		class Upstream : public std::pmr::memory_resource
+		{
+		public:
+			explicit Upstream(ArenaUsage& usage) : m_usage(usage)
+			{
+			}
+
+		private:
+			void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+			void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+
+			bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+			{
+				return this == &other;
+			}
+
+			ArenaUsage& m_usage;
+		};
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+		void do_deallocate(void*, std::size_t, std::size_t) override
+		{
+		}
+
+		bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		static constexpr std::size_t first_block_size = 64 * 1024;
+
+		ArenaUsage m_usage;
+		Upstream m_upstream;
+		alignas(std::max_align_t) std::byte m_first_block[first_block_size];
+		std::pmr::monotonic_buffer_resource m_buffer;
+	};
+}
@@ -0,0 +1,109 @@
+/***************************************************************************************
+    File: clock.h
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    MereTDD clocks for time-dependent code, kept apart from test.h so
+    only the tests that use them pay for <chrono> and <functional>
+ **************************************************************************************/
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace MereTDD
+{
+	// A time source to inject into code under test in place of
+	// steady_clock and sleep_for. Timers scheduled on a clock fire, in
+	// due order, while the clock is slept on or advanced past them.
+	class Clock
+	{
+	public:
+		using duration = std::chrono::nanoseconds;
+		using time_point = std::chrono::time_point<Clock, duration>;
+		using TimerId = std::uint64_t;
+
+		virtual ~Clock() = default;
+
+		virtual time_point now() const = 0;
+
+		virtual void sleep_for(duration delay) = 0;
+
+		TimerId schedule(duration delay, std::function<void()> callback);
+
+		void cancel(TimerId id);
+
+		std::size_t pending_timers() const
+		{
+			return m_timers.size();
+		}
+
+	protected:
+		// Removes and returns the earliest timer due no later than limit.
+		// Timers due at the same time fire in the order they were added.
+		bool pop_due_timer(time_point limit, time_point& due, std::function<void()>& callback);
+
+		bool next_due(time_point& due) const;
+
+		void clear_timers()
+		{
+			m_timers.clear();
+		}
+
+	private:
+		struct Timer
+		{
+			TimerId id;
+			time_point due;
+			std::function<void()> callback;
+		};
+
+		std::vector<Timer> m_timers;
+		TimerId m_next_id{ 1 };
+	};
+
+	// Real time, for production code that takes a Clock.
+	class SystemClock : public Clock
+	{
+	public:
+		time_point now() const override;
+
+		void sleep_for(duration delay) override;
+	};
+
+	// Time that only moves when slept on or advanced, so waiting costs
+	// nothing and timers fire deterministically. Starts at zero.
+	class VirtualClock : public Clock
+	{
+	public:
+		time_point now() const override
+		{
+			return m_now;
+		}
+
+		void sleep_for(duration delay) override
+		{
+			advance(delay);
+		}
+
+		void advance(duration delay);
+
+		void reset()
+		{
+			m_now = time_point{};
+			clear_timers();
+		}
+
+	private:
+		time_point m_now{};
+	};
+}
@@ -0,0 +1,36 @@
+# meretdd_add_test_executables(PREFIX <prefix> MAIN <main.cpp> SOURCES <files>...)
+#
+# Builds one executable per test source instead of a single binary, so a
+# slow translation unit only delays its own executable and an edit only
+# relinks one. A tests_<name>.cpp source becomes <prefix><name>, written
+# to <prefix>bin in the current binary directory. TestDriver runs them in
+# parallel and merges their results, for example:
+#   TestDriver --jobs=8 build/tests/Tests_bin
+function(meretdd_add_test_executables)
+	cmake_parse_arguments(ARG "" "PREFIX;MAIN" "SOURCES" ${ARGN})
+
+	set(OUTPUT_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}/${ARG_PREFIX}bin)
+
+	# main.cpp is compiled once and shared by every executable.
+	add_library(${ARG_PREFIX}main OBJECT ${ARG_MAIN})
+	target_link_libraries(${ARG_PREFIX}main PRIVATE meretdd)
+
+	set(TARGETS)
+	foreach(SOURCE ${ARG_SOURCES})
+		get_filename_component(NAME ${SOURCE} NAME_WE)
+		string(REGEX REPLACE "^tests_" "" NAME ${NAME})
+		set(TARGET ${ARG_PREFIX}${NAME})
+
+		add_executable(${TARGET} ${SOURCE} $<TARGET_OBJECTS:${ARG_PREFIX}main>)
+		target_link_libraries(${TARGET} PRIVATE meretdd)
+		set_target_properties(${TARGET} PROPERTIES RUNTIME_OUTPUT_DIRECTORY ${OUTPUT_DIRECTORY})
+		list(APPEND TARGETS ${TARGET})
+	endforeach()
+
+	if(TARGET TestDriver)
+		add_custom_target(run_${ARG_PREFIX}bin
+				COMMAND TestDriver ${OUTPUT_DIRECTORY}
+				DEPENDS TestDriver ${TARGETS}
+				USES_TERMINAL)
+	endif()
+endfunction()
@@ -0,0 +1,22 @@
+# Runs TestDriver over two executables and checks that it exits with a
+# failure and that its output holds the expected texts.
+#   cmake -DDRIVER=<TestDriver> -DFIRST=<exe> -DSECOND=<exe> -DEXPECTED=<text>
+#         [-DALSO_EXPECTED=<text>] -P check_driver.cmake
+execute_process(COMMAND ${DRIVER} --jobs=2 ${FIRST} ${SECOND}
+		RESULT_VARIABLE RESULT
+		OUTPUT_VARIABLE OUTPUT
+		ERROR_VARIABLE OUTPUT)
+
+foreach(TEXT IN ITEMS "${EXPECTED}" "${ALSO_EXPECTED}")
+	if(TEXT STREQUAL "")
+		continue()
+	endif()
+	string(FIND "${OUTPUT}" "${TEXT}" FOUND)
+	if(FOUND EQUAL -1)
+		message(FATAL_ERROR "TestDriver output is missing:\n${TEXT}\nOutput:\n${OUTPUT}")
+	endif()
+endforeach()
+
+if(RESULT EQUAL 0)
+	message(FATAL_ERROR "TestDriver exited with 0 although a test failed.\nOutput:\n${OUTPUT}")
+endif()
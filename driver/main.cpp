@@ -0,0 +1,255 @@
+/***************************************************************************************
+    File: main.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Runs test executables in parallel and merges their results
+ **************************************************************************************/
+
+#include "../test.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+	struct Job
+	{
+		std::filesystem::path executable;
+		std::string output_file;
+		std::string summary_file;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	bool is_executable(std::filesystem::path const& path)
+	{
+		std::error_code error;
+		return std::filesystem::is_regular_file(path, error) && access(path.c_str(), X_OK) == 0;
+	}
+
+	// Directories are searched for executables whose name starts with the
+	// prefix. Anything else is taken as an executable to run.
+	std::vector<std::filesystem::path> discover(std::vector<std::string> const& paths, std::string_view prefix)
+	{
+		std::vector<std::filesystem::path> executables;
+		for (auto const& path: paths)
+		{
+			std::error_code error;
+			if (!std::filesystem::is_directory(path, error))
+			{
+				executables.emplace_back(path);
+				continue;
+			}
+
+			for (auto const& entry: std::filesystem::directory_iterator(path, error))
+			{
+				if (entry.path().filename().string().starts_with(prefix) && is_executable(entry.path()))
+				{
+					executables.push_back(entry.path());
+				}
+			}
+		}
+		std::sort(executables.begin(), executables.end());
+		return executables;
+	}
+
+	pid_t spawn(Job& job, std::vector<std::string> const& forwarded)
+	{
+		std::vector<std::string> arguments{ job.executable.string() };
+		arguments.insert(arguments.end(), forwarded.begin(), forwarded.end());
+		arguments.push_back("--summary=" + job.summary_file);
+
+		std::vector<char*> argv;
+		for (auto& argument: arguments)
+		{
+			argv.push_back(argument.data());
+		}
+		argv.push_back(nullptr);
+
+		int fd = open(job.output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (fd < 0)
+		{
+			return -1;
+		}
+
+		job.start = std::chrono::steady_clock::now();
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+			execv(argv[0], argv.data());
+			_exit(127);
+		}
+		close(fd);
+		return pid;
+	}
+
+	// Prints the executable's own report as one block, so the reports of
+	// executables running side by side never interleave.
+	void report_job(std::ostream& output, Job const& job, int status, MereTDD::RunSummary& total)
+	{
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - job.start;
+		output << "================ Executable: " << job.executable.filename().string()
+			   << " (" << elapsed.count() << " s)" << std::endl;
+
+		std::ifstream report(job.output_file);
+		output << report.rdbuf();
+		output.clear();
+
+		MereTDD::RunSummary summary;
+		if (!MereTDD::read_summary(job.summary_file, summary))
+		{
+			// The executable crashed or never reached the end of the
+			// run, so its tests cannot be counted one by one.
+			output << "Test executable ";
+			if (WIFSIGNALED(status))
+			{
+				output << "was killed by signal " << WTERMSIG(status);
+			}
+			else
+			{
+				output << "exited with code " << WEXITSTATUS(status)
+					   << " without a summary";
+			}
+			output << '.' << std::endl;
+			++total.failed;
+			return;
+		}
+
+		total.passed += summary.passed;
+		total.failed += summary.failed;
+		total.missed_failed += summary.missed_failed;
+		total.over_limit += summary.over_limit;
+		total.not_run += summary.not_run;
+	}
+}
+
+// TestDriver [--jobs=N] [--prefix=Tests_] <directory or executable>... [-- <test options>]
+int main(int argc, char* argv[])
+{
+	unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+	std::string prefix = "Tests_";
+	std::vector<std::string> paths;
+	std::vector<std::string> forwarded;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg(argv[i]);
+		if (arg == "--")
+		{
+			forwarded.assign(argv + i + 1, argv + argc);
+			break;
+		}
+		else if (arg.starts_with("--jobs="))
+		{
+			jobs = std::max(1, std::atoi(argv[i] + arg.find('=') + 1));
+		}
+		else if (arg.starts_with("--prefix="))
+		{
+			prefix = arg.substr(arg.find('=') + 1);
+		}
+		else
+		{
+			paths.emplace_back(arg);
+		}
+	}
+
+	auto executables = discover(paths, prefix);
+	if (executables.empty())
+	{
+		std::cout << "No test executables found." << std::endl;
+		return 1;
+	}
+
+	std::string scratch = (std::filesystem::temp_directory_path() / "meretdd-driver-XXXXXX").string();
+	if (mkdtemp(scratch.data()) == nullptr)
+	{
+		std::cout << "Cannot create a directory for test output." << std::endl;
+		return 1;
+	}
+
+	std::vector<Job> queue;
+	for (std::size_t i = 0; i < executables.size(); ++i)
+	{
+		std::string base = scratch + "/" + std::to_string(i);
+		queue.push_back({ executables[i], base + ".out", base + ".summary", {} });
+	}
+
+	std::size_t slots = std::min<std::size_t>(jobs, queue.size());
+	std::cout << "Running " << queue.size() << " test executables with "
+			  << slots << (slots == 1 ? " job" : " jobs") << std::endl;
+
+	// Each free slot takes the next executable as soon as one finishes,
+	// so a slow executable never holds up the others.
+	MereTDD::RunSummary total;
+	std::map<pid_t, std::size_t> running;
+	std::size_t next = 0;
+	while (next < queue.size() || !running.empty())
+	{
+		while (running.size() < jobs && next < queue.size())
+		{
+			pid_t pid = spawn(queue[next], forwarded);
+			if (pid < 0)
+			{
+				std::cout << "Cannot start " << queue[next].executable.string() << '.' << std::endl;
+				++total.failed;
+			}
+			else
+			{
+				running[pid] = next;
+			}
+			++next;
+		}
+
+		if (running.empty())
+		{
+			continue;
+		}
+
+		int status = 0;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		auto found = running.find(pid);
+		if (found != running.end())
+		{
+			report_job(std::cout, queue[found->second], status, total);
+			running.erase(found);
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(scratch, error);
+
+	MereTDD::report_summary(std::cout, total);
+	return total.failed;
+}
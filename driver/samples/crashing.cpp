@@ -0,0 +1,22 @@
+/***************************************************************************************
+    File: crashing.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    A test executable that crashes before writing its summary
+ **************************************************************************************/
+
+#include "../../test.h"
+
+#include <cstdlib>
+
+TEST("Sample test that crashes")
+{
+	std::abort();
+}
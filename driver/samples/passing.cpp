@@ -0,0 +1,25 @@
+/***************************************************************************************
+    File: passing.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    A test executable whose tests pass, for checking TestDriver
+ **************************************************************************************/
+
+#include "../../test.h"
+
+TEST("Sample passing test 1")
+{
+	CONFIRM(1, 1);
+}
+
+TEST("Sample passing test 2")
+{
+	CONFIRM_TRUE(true);
+}
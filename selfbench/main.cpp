@@ -0,0 +1,286 @@
+/***************************************************************************************
+    File: main.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Benchmark of the framework's own overhead
+ **************************************************************************************/
+
+#include "../test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+	// Drops everything written to it and counts the bytes, so the
+	// reporter is measured without a terminal or file behind it.
+	class CountingBuffer : public std::streambuf
+	{
+	public:
+		std::uint64_t count() const
+		{
+			return m_count;
+		}
+
+	protected:
+		int_type overflow(int_type ch) override
+		{
+			++m_count;
+			return traits_type::not_eof(ch);
+		}
+
+		std::streamsize xsputn(char const*, std::streamsize count) override
+		{
+			m_count += static_cast<std::uint64_t>(count);
+			return count;
+		}
+
+	private:
+		std::uint64_t m_count{};
+	};
+
+	class EmptyTest : public MereTDD::Test
+	{
+	public:
+		explicit EmptyTest(std::string_view name) : Test(name, "")
+		{
+		}
+
+		void run() override
+		{
+		}
+	};
+
+	class FailingTest : public MereTDD::Test
+	{
+	public:
+		explicit FailingTest(std::string_view name) : Test(name, "")
+		{
+		}
+
+		void run() override
+		{
+			MereTDD::confirm(1, 2);
+		}
+	};
+
+	struct Measurement
+	{
+		std::string name;
+		std::uint64_t operations{};
+		double ns_per_operation{};
+		// Only set for measurements that produce report output.
+		double bytes_per_second{};
+	};
+
+	constexpr int default_repeats = 5;
+
+	// The body performs all operations once. The fastest of a few
+	// repeats is kept to leave scheduler noise out.
+	template<typename Body>
+	double fastest_ns(std::uint64_t operations, Body body, int repeats = default_repeats)
+	{
+		double fastest = std::numeric_limits<double>::max();
+		for (int repeat = 0; repeat < repeats; ++repeat)
+		{
+			auto start = std::chrono::steady_clock::now();
+			body();
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			fastest = std::min(fastest, elapsed.count());
+		}
+		return fastest / static_cast<double>(operations);
+	}
+
+	template<typename T>
+	void measure_confirm(std::vector<Measurement>& results, std::string_view type,
+			T const& expected, T const& different)
+	{
+		constexpr std::uint64_t passing = 1'000'000;
+		constexpr std::uint64_t failing = 20'000;
+
+		// Read through volatile pointers so the comparisons cannot be
+		// folded away.
+		T const copy = expected;
+		T const* volatile expected_ptr = &expected;
+		T const* volatile actual_ptr = &copy;
+		T const* volatile different_ptr = &different;
+
+		std::string name = "confirm/";
+		name += type;
+		results.push_back({ name + "/pass", passing, fastest_ns(passing, [&]()
+		{
+			for (std::uint64_t i = 0; i < passing; ++i)
+			{
+				MereTDD::confirm(*expected_ptr, *actual_ptr);
+			}
+		}) });
+
+		results.push_back({ name + "/fail", failing, fastest_ns(failing, [&]()
+		{
+			for (std::uint64_t i = 0; i < failing; ++i)
+			{
+				try
+				{
+					MereTDD::confirm(*expected_ptr, *different_ptr);
+				}
+				catch (MereTDD::ConfirmException const& ex)
+				{
+					MereTDD::do_not_optimize(ex.line());
+				}
+			}
+		}) });
+	}
+
+	void measure_dispatch(std::vector<Measurement>& results, std::string_view name, MereTDD::Test* test)
+	{
+		constexpr std::uint64_t runs = 200'000;
+
+		CountingBuffer buffer;
+		std::ostream output(&buffer);
+		int num_passed = 0;
+		int num_failed = 0;
+		int num_missed_failed = 0;
+		double ns = fastest_ns(runs, [&]()
+		{
+			for (std::uint64_t i = 0; i < runs; ++i)
+			{
+				MereTDD::run_test(output, test, num_passed, num_failed, num_missed_failed);
+			}
+		});
+
+		auto bytes_per_run = static_cast<double>(buffer.count()) / static_cast<double>(default_repeats * runs);
+		results.push_back({ std::string(name), runs, ns, bytes_per_run * 1e9 / ns });
+	}
+
+	// Registers generated tests up to each size and runs them all, so the
+	// per-test cost shows whether the runner stays linear.
+	void measure_scaling(std::vector<Measurement>& results, std::uint64_t max_tests)
+	{
+		std::vector<std::unique_ptr<EmptyTest>> tests;
+		tests.reserve(max_tests);
+
+		for (std::uint64_t size = 1000; size <= max_tests; size *= 10)
+		{
+			std::vector<std::string> names;
+			names.reserve(size - tests.size());
+			for (std::uint64_t i = tests.size(); i < size; ++i)
+			{
+				names.push_back("Generated test " + std::to_string(i));
+			}
+
+			std::uint64_t added = names.size();
+			double register_ns = fastest_ns(added, [&]()
+			{
+				for (auto const& name: names)
+				{
+					tests.push_back(std::make_unique<EmptyTest>(name));
+				}
+			}, 1);
+			results.push_back({ "scaling/" + std::to_string(size) + "/add_test", added, register_ns });
+
+			CountingBuffer buffer;
+			std::ostream output(&buffer);
+			double run_ns = fastest_ns(size, [&]()
+			{
+				MereTDD::run_tests(output);
+			}, 1);
+			results.push_back({ "scaling/" + std::to_string(size) + "/run_tests", size, run_ns,
+								static_cast<double>(buffer.count()) * 1e9 / (run_ns * static_cast<double>(size)) });
+		}
+
+		// Newest first, which is the order the registry finds them in
+		// fastest as they unregister themselves.
+		while (!tests.empty())
+		{
+			tests.pop_back();
+		}
+	}
+
+	void write_json(std::ostream& output, std::vector<Measurement> const& results)
+	{
+		output << "{\"benchmarks\":[";
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			auto const& result = results[i];
+			output << (i == 0 ? "\n" : ",\n")
+				   << "{\"name\":\"" << result.name
+				   << "\",\"operations\":" << result.operations
+				   << ",\"ns_per_operation\":" << result.ns_per_operation;
+			if (result.bytes_per_second != 0)
+			{
+				output << ",\"bytes_per_second\":" << result.bytes_per_second;
+			}
+			output << '}';
+		}
+		output << "\n]}" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::uint64_t max_tests = 1'000'000;
+	std::string output_path;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg(argv[i]);
+		if (arg.starts_with("--tests="))
+		{
+			max_tests = std::strtoull(argv[i] + arg.find('=') + 1, nullptr, 10);
+		}
+		else if (arg.starts_with("--output="))
+		{
+			output_path = arg.substr(arg.find('=') + 1);
+		}
+	}
+
+	std::vector<Measurement> results;
+
+	measure_confirm(results, "bool", true, false);
+	measure_confirm(results, "int", 42, 43);
+	measure_confirm(results, "long_long", 42LL, 43LL);
+	measure_confirm(results, "float", 1.5f, 2.5f);
+	measure_confirm(results, "double", 1.5, 2.5);
+	measure_confirm(results, "long_double", 1.5L, 2.5L);
+	measure_confirm(results, "string_view", std::string_view("expected value"), std::string_view("expected_value"));
+	measure_confirm(results, "string", std::string("expected value"), std::string("expected_value"));
+	measure_confirm(results, "vector", std::vector<int>(16, 7), std::vector<int>(17, 7));
+
+	// Gone again before the scaling runs, which only run the generated
+	// tests.
+	{
+		EmptyTest passing("Dispatch passing test");
+		FailingTest failing("Dispatch failing test");
+		measure_dispatch(results, "run_test/pass", &passing);
+		measure_dispatch(results, "run_test/fail", &failing);
+	}
+
+	measure_scaling(results, max_tests);
+
+	if (output_path.empty())
+	{
+		write_json(std::cout, results);
+		return 0;
+	}
+
+	std::ofstream file(output_path, std::ios::trunc);
+	write_json(file, results);
+	return file ? 0 : 1;
+}
@@ -0,0 +1,4597 @@
+/***************************************************************************************
+    File: test.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    MereTDD runner implementation
+ **************************************************************************************/
+
+#include "test.h"
+#include "arena.h"
+#include "clock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#ifdef MERETDD_HAS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef MERETDD_HAS_MALLINFO2
+#include <malloc.h>
+#endif
+
+namespace MereTDD
+{
+	namespace
+	{
+		std::map<std::string, std::vector<Test*>>& get_tests()
+		{
+			static std::map<std::string, std::vector<Test*>> tests;
+
+			return tests;
+		}
+
+		std::map<std::string, std::vector<TestSuite*>>& get_test_suites()
+		{
+			static std::map<std::string, std::vector<TestSuite*>> suites;
+
+			return suites;
+		}
+
+		std::vector<Benchmark*>& get_benchmarks()
+		{
+			static std::vector<Benchmark*> benchmarks;
+
+			return benchmarks;
+		}
+
+		std::map<std::string, ResourceLimits>& get_suite_resource_limits()
+		{
+			static std::map<std::string, ResourceLimits> limits;
+
+			return limits;
+		}
+
+		// Sites of the running test, keyed by file and line so the
+		// probe and the confirm behind it land in the same entry.
+		std::map<std::pair<std::string_view, int>, ConfirmSite>& get_test_confirm_sites()
+		{
+			static std::map<std::pair<std::string_view, int>, ConfirmSite> sites;
+
+			return sites;
+		}
+
+		std::atomic<std::uint64_t>& get_confirm_counter()
+		{
+			static std::atomic<std::uint64_t> count{ 0 };
+
+			return count;
+		}
+
+		void record_confirm_site(std::source_location const& location)
+		{
+			auto& site = get_test_confirm_sites()[{ location.file_name(), static_cast<int>(location.line()) }];
+			if (site.file.empty())
+			{
+				site.file = location.file_name();
+				site.line = static_cast<int>(location.line());
+			}
+			++site.checks;
+		}
+
+		struct CheckTotals
+		{
+			std::uint64_t checks{};
+			std::int64_t body_ns{};
+			std::map<std::pair<std::string, int>, ConfirmSite> sites;
+		};
+
+		CheckTotals& get_check_totals()
+		{
+			static CheckTotals totals;
+
+			return totals;
+		}
+
+		// Each run counts its own checks. A run started inside a test
+		// puts the totals of the run around it back when it ends.
+		class CheckTotalsScope
+		{
+		public:
+			CheckTotalsScope() :
+					m_outer(std::exchange(get_check_totals(), {}))
+			{
+			}
+
+			CheckTotalsScope(CheckTotalsScope const&) = delete;
+
+			CheckTotalsScope& operator=(CheckTotalsScope const&) = delete;
+
+			~CheckTotalsScope()
+			{
+				get_check_totals() = std::move(m_outer);
+			}
+
+		private:
+			CheckTotals m_outer;
+		};
+
+		// The test whose body is running, if any.
+		Test*& get_current_test()
+		{
+			static Test* test = nullptr;
+
+			return test;
+		}
+
+		// A run started inside a test gets an arena of its own, so the
+		// memory the outer test allocated stays live.
+		TestArena*& get_current_arena()
+		{
+			static TestArena arena;
+			static TestArena* current = &arena;
+
+			return current;
+		}
+
+		// Puts aside what execute_test resets for every test, so a run
+		// started inside a test hands the outer test back its arena,
+		// clock and confirm counts unchanged.
+		class TestStateScope
+		{
+		public:
+			TestStateScope() :
+					m_arena(std::make_unique<TestArena>()),
+					m_outer_arena(std::exchange(get_current_arena(), m_arena.get())),
+					m_outer_clock(std::exchange(get_test_clock(), {})),
+					m_outer_confirm_count(get_confirm_counter().load(std::memory_order_relaxed)),
+					m_outer_confirm_profiling(get_confirm_profiling()),
+					m_outer_confirm_sites(std::exchange(get_test_confirm_sites(), {}))
+			{
+			}
+
+			TestStateScope(TestStateScope const&) = delete;
+
+			TestStateScope& operator=(TestStateScope const&) = delete;
+
+			~TestStateScope()
+			{
+				get_current_arena() = m_outer_arena;
+				get_test_clock() = std::move(m_outer_clock);
+				get_confirm_counter().store(m_outer_confirm_count, std::memory_order_relaxed);
+				get_confirm_profiling() = m_outer_confirm_profiling;
+				get_test_confirm_sites() = std::move(m_outer_confirm_sites);
+			}
+
+		private:
+			std::unique_ptr<TestArena> m_arena;
+			TestArena* m_outer_arena;
+			VirtualClock m_outer_clock;
+			std::uint64_t m_outer_confirm_count;
+			bool m_outer_confirm_profiling;
+			std::map<std::pair<std::string_view, int>, ConfirmSite> m_outer_confirm_sites;
+		};
+
+		bool& is_isolated_child()
+		{
+			static bool isolated = false;
+
+			return isolated;
+		}
+
+		bool has_limits(ResourceLimits const& limits)
+		{
+			return limits.address_space != 0 || limits.cpu_seconds != 0 || limits.open_files != 0;
+		}
+
+		// Command line limits apply to every test and a suite's own
+		// limits replace them field by field.
+		ResourceLimits effective_limits(Test const* test)
+		{
+			ResourceLimits limits = get_run_options().limits;
+			auto suite = get_suite_resource_limits().find(std::string(test->suite_name()));
+			if (suite != get_suite_resource_limits().end())
+			{
+				auto const& override_limits = suite->second;
+				if (override_limits.address_space != 0)
+				{
+					limits.address_space = override_limits.address_space;
+				}
+				if (override_limits.cpu_seconds != 0)
+				{
+					limits.cpu_seconds = override_limits.cpu_seconds;
+				}
+				if (override_limits.open_files != 0)
+				{
+					limits.open_files = override_limits.open_files;
+				}
+			}
+			return limits;
+		}
+
+		std::string limit_reason(ResourceLimit limit, ResourceLimits const& limits)
+		{
+			std::string reason = "Resource limit exceeded: ";
+			switch (limit)
+			{
+			case ResourceLimit::address_space:
+				reason += "address space of " + std::to_string(limits.address_space) + " bytes.";
+				break;
+			case ResourceLimit::cpu_time:
+				reason += "CPU time of " + std::to_string(limits.cpu_seconds) + " seconds.";
+				break;
+			case ResourceLimit::open_files:
+				reason += std::to_string(limits.open_files) + " open files.";
+				break;
+			case ResourceLimit::none:
+				break;
+			}
+			return reason;
+		}
+
+		// Fixed-width little-endian numbers and length-prefixed strings.
+		// Used to pass results back from isolated test processes.
+		class RecordWriter
+		{
+		public:
+			void put_number(std::uint64_t value)
+			{
+				for (int i = 0; i < 8; ++i)
+				{
+					m_data += static_cast<char>((value >> (i * 8)) & 0xff);
+				}
+			}
+
+			void put_string(std::string_view text)
+			{
+				put_number(text.size());
+				m_data += text;
+			}
+
+			std::string const& data() const
+			{
+				return m_data;
+			}
+
+		private:
+			std::string m_data;
+		};
+
+		class RecordReader
+		{
+		public:
+			explicit RecordReader(std::string_view data) : m_data(data)
+			{
+			}
+
+			std::uint64_t get_number()
+			{
+				if (m_data.size() < 8)
+				{
+					m_ok = false;
+					return 0;
+				}
+
+				std::uint64_t value = 0;
+				for (int i = 0; i < 8; ++i)
+				{
+					value |= static_cast<std::uint64_t>(static_cast<unsigned char>(m_data[i])) << (i * 8);
+				}
+				m_data.remove_prefix(8);
+				return value;
+			}
+
+			std::string_view get_string()
+			{
+				std::uint64_t size = get_number();
+				if (!m_ok || size > m_data.size())
+				{
+					m_ok = false;
+					return {};
+				}
+
+				std::string_view text = m_data.substr(0, size);
+				m_data.remove_prefix(size);
+				return text;
+			}
+
+			bool ok() const
+			{
+				return m_ok;
+			}
+
+		private:
+			std::string_view m_data;
+			bool m_ok{ true };
+		};
+
+		void write_result(RecordWriter& record, Test const* test)
+		{
+			record.put_number(test->passed() ? 1 : 0);
+			record.put_string(test->reason());
+			record.put_number(static_cast<std::uint64_t>(static_cast<std::int64_t>(test->confirm_location())));
+			record.put_string(test->expected_reason());
+			record.put_number(static_cast<std::uint64_t>(test->limit_exceeded()));
+
+			record.put_number(test->perf_counts().size());
+			for (auto const& count: test->perf_counts())
+			{
+				record.put_string(count.name);
+				record.put_number(count.value);
+			}
+
+			auto const& usage = test->memory_usage();
+			record.put_number(usage.sampled ? 1 : 0);
+			record.put_number(static_cast<std::uint64_t>(usage.resident_delta));
+			record.put_number(static_cast<std::uint64_t>(usage.peak_resident));
+			record.put_number(static_cast<std::uint64_t>(usage.peak_growth));
+			record.put_number(static_cast<std::uint64_t>(usage.leaked_heap));
+
+			auto const& arena = test->arena_usage();
+			record.put_number(arena.allocations);
+			record.put_number(arena.bytes_allocated);
+			record.put_number(arena.bytes_reserved);
+
+			auto const& checks = test->check_stats();
+			record.put_number(checks.checks);
+			record.put_number(static_cast<std::uint64_t>(checks.body_ns));
+			record.put_number(checks.sites.size());
+			for (auto const& site: checks.sites)
+			{
+				record.put_string(site.file);
+				record.put_number(static_cast<std::uint64_t>(site.line));
+				record.put_number(site.checks);
+				record.put_number(static_cast<std::uint64_t>(site.ns));
+			}
+		}
+
+		bool read_result(RecordReader& record, Test* test)
+		{
+			bool passed = record.get_number() != 0;
+			std::string reason(record.get_string());
+			auto confirm_location = static_cast<int>(static_cast<std::int64_t>(record.get_number()));
+			std::string expected_reason(record.get_string());
+			auto limit = static_cast<ResourceLimit>(record.get_number());
+
+			std::vector<PerfCount> counts;
+			std::uint64_t num_counts = record.get_number();
+			for (std::uint64_t i = 0; record.ok() && i < num_counts; ++i)
+			{
+				PerfCount count;
+				count.name = record.get_string();
+				count.value = record.get_number();
+				counts.push_back(std::move(count));
+			}
+
+			MemoryUsage usage;
+			usage.sampled = record.get_number() != 0;
+			usage.resident_delta = static_cast<std::int64_t>(record.get_number());
+			usage.peak_resident = static_cast<std::int64_t>(record.get_number());
+			usage.peak_growth = static_cast<std::int64_t>(record.get_number());
+			usage.leaked_heap = static_cast<std::int64_t>(record.get_number());
+
+			ArenaUsage arena;
+			arena.allocations = record.get_number();
+			arena.bytes_allocated = record.get_number();
+			arena.bytes_reserved = record.get_number();
+
+			CheckStats checks;
+			checks.checks = record.get_number();
+			checks.body_ns = static_cast<std::int64_t>(record.get_number());
+			std::uint64_t num_sites = record.get_number();
+			for (std::uint64_t i = 0; record.ok() && i < num_sites; ++i)
+			{
+				ConfirmSite site;
+				site.file = record.get_string();
+				site.line = static_cast<int>(record.get_number());
+				site.checks = record.get_number();
+				site.ns = static_cast<std::int64_t>(record.get_number());
+				checks.sites.push_back(std::move(site));
+			}
+
+			if (!record.ok())
+			{
+				return false;
+			}
+
+			if (limit != ResourceLimit::none)
+			{
+				test->set_limit_exceeded(limit, reason);
+			}
+			else if (!passed)
+			{
+				test->set_failed(reason, confirm_location);
+			}
+			test->set_expected_failure_reason(expected_reason);
+			test->set_perf_counts(std::move(counts));
+			test->set_memory_usage(usage);
+			test->set_arena_usage(arena);
+			test->set_check_stats(std::move(checks));
+			return true;
+		}
+
+		MemoryUsage measure_memory(MemorySample const& before, MemorySample const& after)
+		{
+			MemoryUsage usage;
+			usage.sampled = true;
+			usage.resident_delta = after.resident - before.resident;
+			usage.peak_resident = after.peak_resident;
+			usage.peak_growth = after.peak_resident - before.peak_resident;
+			usage.leaked_heap = after.live_heap - before.live_heap;
+			return usage;
+		}
+
+		// Counts hardware events for the calling thread when the PMU is
+		// reachable and falls back to the kernel's software events otherwise.
+		// All events share one group so they are enabled and read together.
+		class PerfCounters
+		{
+		public:
+			PerfCounters()
+			{
+				open();
+			}
+
+			PerfCounters(PerfCounters const&) = delete;
+
+			PerfCounters& operator=(PerfCounters const&) = delete;
+
+			~PerfCounters()
+			{
+				close_group();
+			}
+
+			// The group counts the thread that opened it, so a forked
+			// child inherits counters of its parent and has to open its
+			// own.
+			void reopen()
+			{
+				close_group();
+				open();
+			}
+
+			bool available() const
+			{
+				return !m_fds.empty();
+			}
+
+			bool hardware() const
+			{
+				return m_hardware;
+			}
+
+			void start()
+			{
+#ifdef __linux__
+				if (available())
+				{
+					ioctl(m_fds.front(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+					ioctl(m_fds.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+				}
+#endif
+			}
+
+			std::vector<PerfCount> stop()
+			{
+				std::vector<PerfCount> counts;
+#ifdef __linux__
+				if (!available())
+				{
+					return counts;
+				}
+
+				ioctl(m_fds.front(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+				// Layout for PERF_FORMAT_GROUP with both time fields:
+				// nr, time_enabled, time_running, value[nr]
+				std::vector<std::uint64_t> data(3 + m_fds.size());
+				auto bytes = static_cast<ssize_t>(data.size() * sizeof(std::uint64_t));
+				if (read(m_fds.front(), data.data(), bytes) != bytes)
+				{
+					return counts;
+				}
+
+				std::uint64_t enabled = data[1];
+				std::uint64_t running = data[2];
+				for (std::size_t i = 0; i < m_names.size() && i < data[0]; ++i)
+				{
+					std::uint64_t value = data[3 + i];
+					if (running != 0 && running < enabled)
+					{
+						// The PMU was multiplexed, so extrapolate the count
+						// over the whole time the group was enabled.
+						value = static_cast<std::uint64_t>(
+								static_cast<long double>(value) * enabled / running);
+					}
+					counts.push_back({ m_names[i], value });
+				}
+#endif
+				return counts;
+			}
+
+		private:
+			struct Event
+			{
+				char const* name;
+				std::uint32_t type;
+				std::uint64_t config;
+			};
+
+			void open()
+			{
+#ifdef __linux__
+				static constexpr Event hardware_events[] = {
+						{ "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+						{ "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+						{ "cache-misses",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+						{ "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+				};
+				static constexpr Event software_events[] = {
+						{ "task-clock-ns",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+						{ "page-faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+						{ "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+						{ "cpu-migrations",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+				};
+
+				m_hardware = open_group(hardware_events);
+				if (!m_hardware)
+				{
+					open_group(software_events);
+				}
+#endif
+			}
+
+#ifdef __linux__
+			template<std::size_t N>
+			bool open_group(Event const (& events)[N])
+			{
+				for (auto const& event: events)
+				{
+					perf_event_attr attr{};
+					attr.size = sizeof(attr);
+					attr.type = event.type;
+					attr.config = event.config;
+					attr.disabled = m_fds.empty() ? 1 : 0;
+					attr.exclude_kernel = 1;
+					attr.exclude_hv = 1;
+					attr.read_format = PERF_FORMAT_GROUP
+									   | PERF_FORMAT_TOTAL_TIME_ENABLED
+									   | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+					int group_fd = m_fds.empty() ? -1 : m_fds.front();
+					auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+					if (fd == -1)
+					{
+						if (m_fds.empty())
+						{
+							// Without a leader there is no group to
+							// join, so this event set is unusable.
+							return false;
+						}
+						continue;
+					}
+
+					m_fds.push_back(fd);
+					m_names.emplace_back(event.name);
+				}
+				return true;
+			}
+#endif
+
+			void close_group()
+			{
+#ifdef __linux__
+				for (auto it = m_fds.rbegin(); it != m_fds.rend(); ++it)
+				{
+					close(*it);
+				}
+#endif
+				m_fds.clear();
+				m_names.clear();
+			}
+
+			std::vector<int> m_fds;
+			std::vector<std::string> m_names;
+			bool m_hardware{ false };
+		};
+
+		PerfCounters& get_perf_counters()
+		{
+			static PerfCounters counters;
+
+			return counters;
+		}
+
+		void report_perf_counts(std::ostream& output, TestBase const* test)
+		{
+			if (test->perf_counts().empty())
+			{
+				return;
+			}
+
+			output << "    Counters:";
+			for (auto const& count: test->perf_counts())
+			{
+				output << ' ' << count.name << '=' << count.value;
+			}
+			output << std::endl;
+		}
+
+		extern "C" void handle_interrupt(int)
+		{
+			// The first interrupt asks running tests to wind down and
+			// lets teardowns run. A second one terminates as usual.
+			get_cancellation_token().cancel();
+			std::signal(SIGINT, SIG_DFL);
+		}
+
+		class InterruptCancellation
+		{
+		public:
+			InterruptCancellation() : m_previous(std::signal(SIGINT, handle_interrupt))
+			{
+			}
+
+			InterruptCancellation(InterruptCancellation const&) = delete;
+
+			InterruptCancellation& operator=(InterruptCancellation const&) = delete;
+
+			~InterruptCancellation()
+			{
+				std::signal(SIGINT, m_previous == SIG_ERR ? SIG_DFL : m_previous);
+			}
+
+		private:
+			void (* m_previous)(int);
+		};
+
+		// Read-only view of a whole file. Mapped where the platform allows
+		// so multi-megabyte golden files are never copied.
+		class MappedFile
+		{
+		public:
+			explicit MappedFile(std::filesystem::path const& path)
+			{
+#ifdef MERETDD_HAS_POSIX
+				int fd = open(path.c_str(), O_RDONLY);
+				if (fd == -1)
+				{
+					return;
+				}
+
+				struct stat info{};
+				if (fstat(fd, &info) == 0)
+				{
+					m_exists = true;
+					auto size = static_cast<std::size_t>(info.st_size);
+					if (size != 0)
+					{
+						void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+						if (data != MAP_FAILED)
+						{
+							madvise(data, size, MADV_SEQUENTIAL);
+							m_mapping = data;
+							m_contents = std::string_view(static_cast<char const*>(data), size);
+						}
+					}
+				}
+				close(fd);
+
+				if (m_mapping != nullptr || !m_exists || m_contents.empty() == false)
+				{
+					return;
+				}
+#endif
+				std::ifstream file(path, std::ios::binary);
+				if (!file)
+				{
+					return;
+				}
+				m_exists = true;
+				m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+				m_contents = m_buffer;
+			}
+
+			MappedFile(MappedFile const&) = delete;
+
+			MappedFile& operator=(MappedFile const&) = delete;
+
+			~MappedFile()
+			{
+#ifdef MERETDD_HAS_POSIX
+				if (m_mapping != nullptr)
+				{
+					munmap(m_mapping, m_contents.size());
+				}
+#endif
+			}
+
+			bool exists() const
+			{
+				return m_exists;
+			}
+
+			std::string_view contents() const
+			{
+				return m_contents;
+			}
+
+		private:
+			bool m_exists{ false };
+			void* m_mapping{ nullptr };
+			std::string m_buffer;
+			std::string_view m_contents;
+		};
+
+		// Offset of the first byte that differs, or the length of the
+		// shorter input when one is a prefix of the other. Whole blocks
+		// are skipped with memcmp, which the C library vectorizes.
+		std::size_t first_difference(std::string_view a, std::string_view b)
+		{
+			constexpr std::size_t block = 4096;
+			std::size_t size = std::min(a.size(), b.size());
+			std::size_t offset = 0;
+			while (offset + block <= size && std::memcmp(a.data() + offset, b.data() + offset, block) == 0)
+			{
+				offset += block;
+			}
+			while (offset < size && a[offset] == b[offset])
+			{
+				++offset;
+			}
+			return offset;
+		}
+
+		// Keeps an excerpt on one line of the report.
+		void append_escaped(std::string& output, std::string_view text)
+		{
+			static constexpr char digits[] = "0123456789abcdef";
+			for (char c: text)
+			{
+				switch (c)
+				{
+				case '\n':
+					output += "\\n";
+					break;
+				case '\r':
+					output += "\\r";
+					break;
+				case '\t':
+					output += "\\t";
+					break;
+				case '"':
+					output += "\\\"";
+					break;
+				case '\\':
+					output += "\\\\";
+					break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+					{
+						output += "\\x";
+						output += digits[(c >> 4) & 0xf];
+						output += digits[c & 0xf];
+					}
+					else
+					{
+						output += c;
+					}
+				}
+			}
+		}
+
+		std::vector<std::string_view> split_lines(std::string_view text)
+		{
+			std::vector<std::string_view> lines;
+			while (!text.empty())
+			{
+				auto end = text.find('\n');
+				if (end == std::string_view::npos)
+				{
+					lines.push_back(text);
+					break;
+				}
+				lines.push_back(text.substr(0, end));
+				text.remove_prefix(end + 1);
+			}
+			return lines;
+		}
+
+		enum class EditKind
+		{
+			equal,
+			remove,
+			insert
+		};
+
+		// One step of a line diff. For removals a_line is the removed line
+		// and b_line is where it would have been in b, and the other way
+		// around for insertions.
+		struct Edit
+		{
+			EditKind kind;
+			std::size_t a_line;
+			std::size_t b_line;
+		};
+
+		// Myers' O((N+M)D) shortest edit script. Only the diagonal band
+		// reached at each step is kept, so memory is O(D^2). Gives up
+		// when more than max_edits lines differ.
+		std::optional<std::vector<Edit>> diff_lines(std::vector<std::string_view> const& a,
+				std::vector<std::string_view> const& b, std::size_t max_edits)
+		{
+			auto n = static_cast<long>(a.size());
+			auto m = static_cast<long>(b.size());
+			auto limit = static_cast<long>(std::min<std::size_t>(max_edits, a.size() + b.size()));
+
+			std::vector<long> v(static_cast<std::size_t>(2 * limit + 3), 0);
+			auto at = [&](long k) -> long&
+			{
+				return v[static_cast<std::size_t>(k + limit + 1)];
+			};
+
+			std::vector<std::vector<long>> trace;
+			bool found = false;
+			for (long d = 0; d <= limit && !found; ++d)
+			{
+				std::vector<long> band(static_cast<std::size_t>(2 * d + 1));
+				for (long k = -d; k <= d; k += 2)
+				{
+					long x = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? at(k + 1) : at(k - 1) + 1;
+					long y = x - k;
+					while (x < n && y < m && a[static_cast<std::size_t>(x)] == b[static_cast<std::size_t>(y)])
+					{
+						++x;
+						++y;
+					}
+					at(k) = x;
+					band[static_cast<std::size_t>(k + d)] = x;
+					if (x >= n && y >= m)
+					{
+						found = true;
+						break;
+					}
+				}
+				trace.push_back(std::move(band));
+			}
+
+			if (!found)
+			{
+				return std::nullopt;
+			}
+
+			std::vector<Edit> edits;
+			long x = n;
+			long y = m;
+			for (auto d = static_cast<long>(trace.size()) - 1; d > 0; --d)
+			{
+				auto const& previous = trace[static_cast<std::size_t>(d - 1)];
+				auto previous_at = [&](long k)
+				{
+					return previous[static_cast<std::size_t>(k + d - 1)];
+				};
+
+				long k = x - y;
+				long previous_k = (k == -d || (k != d && previous_at(k - 1) < previous_at(k + 1))) ? k + 1 : k - 1;
+				long previous_x = previous_at(previous_k);
+				long previous_y = previous_x - previous_k;
+
+				while (x > previous_x && y > previous_y)
+				{
+					--x;
+					--y;
+					edits.push_back({ EditKind::equal, static_cast<std::size_t>(x), static_cast<std::size_t>(y) });
+				}
+
+				if (x == previous_x)
+				{
+					--y;
+					edits.push_back({ EditKind::insert, static_cast<std::size_t>(x), static_cast<std::size_t>(y) });
+				}
+				else
+				{
+					--x;
+					edits.push_back({ EditKind::remove, static_cast<std::size_t>(x), static_cast<std::size_t>(y) });
+				}
+			}
+			while (x > 0 && y > 0)
+			{
+				--x;
+				--y;
+				edits.push_back({ EditKind::equal, static_cast<std::size_t>(x), static_cast<std::size_t>(y) });
+			}
+
+			std::reverse(edits.begin(), edits.end());
+			return edits;
+		}
+
+		void append_diff_line(std::string& output, char marker, std::string_view line)
+		{
+			constexpr std::size_t max_line = 200;
+			output += "    ";
+			output += marker;
+			if (line.size() > max_line)
+			{
+				output += line.substr(0, max_line);
+				output += "... (" + std::to_string(line.size()) + " bytes)";
+			}
+			else
+			{
+				output += line;
+			}
+			output += '\n';
+		}
+
+		// Unified diff hunks with a few lines of context around each
+		// change. first_line is the 1-based number of a[0] and b[0].
+		void append_hunks(std::string& output, std::vector<Edit> const& edits,
+				std::vector<std::string_view> const& a, std::vector<std::string_view> const& b,
+				std::size_t a_first_line, std::size_t b_first_line)
+		{
+			constexpr std::size_t context = 3;
+			constexpr std::size_t max_output_lines = 200;
+			std::size_t output_lines = 0;
+
+			std::size_t i = 0;
+			while (i < edits.size())
+			{
+				if (edits[i].kind == EditKind::equal)
+				{
+					++i;
+					continue;
+				}
+
+				std::size_t start = i >= context ? i - context : 0;
+				std::size_t end = i;
+				std::size_t j = i;
+				while (j < edits.size())
+				{
+					if (edits[j].kind != EditKind::equal)
+					{
+						end = ++j;
+						continue;
+					}
+
+					std::size_t run = j;
+					while (run < edits.size() && edits[run].kind == EditKind::equal)
+					{
+						++run;
+					}
+					if (run == edits.size() || run - j > 2 * context)
+					{
+						break;
+					}
+					j = run;
+				}
+				std::size_t stop = std::min(edits.size(), end + context);
+
+				std::size_t a_count = 0;
+				std::size_t b_count = 0;
+				for (std::size_t e = start; e < stop; ++e)
+				{
+					a_count += edits[e].kind != EditKind::insert ? 1 : 0;
+					b_count += edits[e].kind != EditKind::remove ? 1 : 0;
+				}
+				output += "    @@ -" + std::to_string(a_first_line + edits[start].a_line) + ',' + std::to_string(a_count)
+						  + " +" + std::to_string(b_first_line + edits[start].b_line) + ',' + std::to_string(b_count)
+						  + " @@\n";
+
+				for (std::size_t e = start; e < stop; ++e)
+				{
+					if (++output_lines > max_output_lines)
+					{
+						output += "    ... (diff truncated)\n";
+						return;
+					}
+
+					switch (edits[e].kind)
+					{
+					case EditKind::equal:
+						append_diff_line(output, ' ', a[edits[e].a_line]);
+						break;
+					case EditKind::remove:
+						append_diff_line(output, '-', a[edits[e].a_line]);
+						break;
+					case EditKind::insert:
+						append_diff_line(output, '+', b[edits[e].b_line]);
+						break;
+					}
+				}
+				i = stop;
+			}
+		}
+
+		// Describes how actual differs from expected using only the lines
+		// around the changes. Lines shared at both ends are counted but
+		// never split or diffed.
+		std::string describe_text_difference(std::string_view expected, std::string_view actual)
+		{
+			constexpr std::size_t context = 3;
+			constexpr std::size_t max_edits = 1000;
+
+			std::size_t offset = first_difference(expected, actual);
+			std::string output = "    Expected " + std::to_string(expected.size()) + " bytes, actual "
+								 + std::to_string(actual.size()) + " bytes, first difference at byte "
+								 + std::to_string(offset) + '\n';
+
+			// Back up to the start of the line holding the first
+			// difference, then keep a few more lines for context.
+			auto line_start = [&](std::size_t position) -> std::size_t
+			{
+				auto newline = position == 0 ? std::string_view::npos : expected.rfind('\n', position - 1);
+				return newline == std::string_view::npos ? 0 : newline + 1;
+			};
+			std::size_t prefix = line_start(offset);
+			for (std::size_t lines = 0; prefix != 0 && lines < context; ++lines)
+			{
+				prefix = line_start(prefix - 1);
+			}
+			auto prefix_lines = static_cast<std::size_t>(std::count(expected.data(), expected.data() + prefix, '\n'));
+
+			// Same for the common tail, which must not reach back past
+			// the first difference.
+			std::size_t suffix = 0;
+			std::size_t max_suffix = std::min(expected.size(), actual.size()) - offset;
+			while (suffix < max_suffix && expected[expected.size() - 1 - suffix] == actual[actual.size() - 1 - suffix])
+			{
+				++suffix;
+			}
+			auto skip_line = [&](std::size_t tail) -> std::size_t
+			{
+				auto newline = expected.find('\n', expected.size() - tail);
+				return newline == std::string_view::npos ? 0 : expected.size() - newline - 1;
+			};
+			std::size_t tail = suffix == 0 ? 0 : skip_line(suffix);
+			for (std::size_t lines = 0; tail != 0 && lines < context; ++lines)
+			{
+				tail = skip_line(tail);
+			}
+
+			auto a = split_lines(expected.substr(prefix, expected.size() - prefix - tail));
+			auto b = split_lines(actual.substr(prefix, actual.size() - prefix - tail));
+			auto edits = diff_lines(a, b, max_edits);
+			if (!edits)
+			{
+				output += "    More than " + std::to_string(max_edits) + " lines differ; diff omitted.\n";
+				return output;
+			}
+
+			bool any_change = std::any_of(edits->begin(), edits->end(), [](Edit const& edit)
+			{
+				return edit.kind != EditKind::equal;
+			});
+			if (!any_change)
+			{
+				output += "    Lines match; the texts differ only in line endings.\n";
+				return output;
+			}
+
+			append_hunks(output, *edits, a, b, prefix_lines + 1, prefix_lines + 1);
+			return output;
+		}
+
+		std::filesystem::path snapshot_path(std::string_view name, std::source_location const& location)
+		{
+			std::filesystem::path directory = get_run_options().snapshot_dir;
+			if (directory.empty())
+			{
+				directory = std::filesystem::path(location.file_name()).parent_path() / "snapshots";
+			}
+			return directory / (std::string(name) + ".snap");
+		}
+
+		std::filesystem::path corpus_path(Test const* test)
+		{
+			std::filesystem::path directory = get_run_options().corpus_dir;
+			if (directory.empty())
+			{
+				directory = std::filesystem::path(test->location().file_name()).parent_path() / "corpus";
+			}
+
+			std::string name(test->name());
+			for (char& c: name)
+			{
+				if (!std::isalnum(static_cast<unsigned char>(c)))
+				{
+					c = '_';
+				}
+			}
+			return directory / name;
+		}
+
+		void write_json_string(std::ostream& output, std::string_view text)
+		{
+			output << '"';
+			for (char c: text)
+			{
+				switch (c)
+				{
+				case '"':
+					output << "\\\"";
+					break;
+				case '\\':
+					output << "\\\\";
+					break;
+				case '\n':
+					output << "\\n";
+					break;
+				case '\t':
+					output << "\\t";
+					break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+					{
+						static constexpr char digits[] = "0123456789abcdef";
+						output << "\\u00" << digits[(c >> 4) & 0xf] << digits[c & 0xf];
+					}
+					else
+					{
+						output << c;
+					}
+				}
+			}
+			output << '"';
+		}
+
+		void write_json_location(std::ostream& output, TestBase const* test)
+		{
+			output << "\"file\":";
+			write_json_string(output, test->location().file_name());
+			output << ",\"line\":" << test->location().line();
+		}
+
+		void report_memory_usage(std::ostream& output, TestBase const* test, std::string_view fixture)
+		{
+			auto const& usage = test->memory_usage();
+			if (!usage.sampled)
+			{
+				return;
+			}
+
+			output << "    Memory: rss "
+				   << (usage.resident_delta < 0 ? "" : "+") << usage.resident_delta
+				   << " bytes, peak " << usage.peak_resident
+				   << " bytes (+" << usage.peak_growth << ")"
+				   << std::endl;
+
+			if (usage.leaked_heap > 0)
+			{
+				output << "    Leaked " << usage.leaked_heap
+					   << " heap bytes across " << fixture
+					   << std::endl;
+			}
+		}
+
+		struct TestHistory
+		{
+			// Newest first, 'F' for a failure and 'P' for a pass.
+			std::string outcomes;
+			std::int64_t average_ns{};
+		};
+
+		// Tests are told apart by where they are defined, since names
+		// only have to be unique within a suite and often are not. The
+		// name is kept too, so a test that moved to another test's
+		// line does not inherit its history.
+		using HistoryKey = std::tuple<std::string, int, std::string>;
+
+		HistoryKey history_key(Test const* test)
+		{
+			return { test->location().file_name(), static_cast<int>(test->location().line()), std::string(test->name()) };
+		}
+
+		constexpr std::size_t history_length = 8;
+
+		std::map<HistoryKey, TestHistory> read_history(std::string const& path)
+		{
+			std::map<HistoryKey, TestHistory> history;
+			std::ifstream file(path);
+			std::string line;
+			if (!std::getline(file, line) || line != "meretdd-history 2")
+			{
+				return history;
+			}
+
+			// outcomes, average duration, file, line and test name,
+			// separated by tabs. The name is last so it may hold any
+			// character but a newline.
+			while (std::getline(file, line))
+			{
+				std::size_t tabs[4];
+				std::size_t position = std::string::npos;
+				bool complete = true;
+				for (auto& tab: tabs)
+				{
+					position = line.find('\t', position + 1);
+					if (position == std::string::npos)
+					{
+						complete = false;
+						break;
+					}
+					tab = position;
+				}
+				if (!complete)
+				{
+					continue;
+				}
+
+				TestHistory entry;
+				entry.outcomes = line.substr(0, std::min(tabs[0], history_length));
+				entry.average_ns = std::strtoll(line.c_str() + tabs[0] + 1, nullptr, 10);
+				history[{ line.substr(tabs[1] + 1, tabs[2] - tabs[1] - 1),
+						std::atoi(line.c_str() + tabs[2] + 1),
+						line.substr(tabs[3] + 1) }] = std::move(entry);
+			}
+			return history;
+		}
+
+		void write_history(std::string const& path, std::map<HistoryKey, TestHistory> const& history)
+		{
+			// Written aside and renamed so an interrupted run cannot
+			// leave half a file behind.
+			std::string temporary = path + ".tmp";
+			{
+				std::ofstream file(temporary, std::ios::trunc);
+				file << "meretdd-history 2\n";
+				for (auto const& [key, entry]: history)
+				{
+					file << entry.outcomes << '\t' << entry.average_ns << '\t'
+						 << std::get<0>(key) << '\t' << std::get<1>(key) << '\t' << std::get<2>(key) << '\n';
+				}
+				if (!file)
+				{
+					return;
+				}
+			}
+
+			std::error_code error;
+			std::filesystem::rename(temporary, path, error);
+		}
+
+		void record_history(TestHistory& entry, bool failed, std::int64_t duration_ns)
+		{
+			entry.outcomes.insert(entry.outcomes.begin(), failed ? 'F' : 'P');
+			if (entry.outcomes.size() > history_length)
+			{
+				entry.outcomes.resize(history_length);
+			}
+
+			// Leans on recent runs so a test that got slower moves
+			// back soon.
+			entry.average_ns = entry.average_ns == 0 ? duration_ns : (entry.average_ns + duration_ns) / 2;
+		}
+
+		// Failures count half as much with every run they are older,
+		// and the sum is spread over the test's duration plus a
+		// millisecond so that near-instant tests do not dominate. A test
+		// without history counts like one that failed two runs ago.
+		double history_priority(TestHistory const* entry)
+		{
+			if (entry == nullptr)
+			{
+				return 0.25 / 1e6;
+			}
+
+			double signal = 0;
+			double weight = 1;
+			for (char outcome: entry->outcomes)
+			{
+				if (outcome == 'F')
+				{
+					signal += weight;
+				}
+				weight /= 2;
+			}
+			return signal / (static_cast<double>(entry->average_ns) + 1e6);
+		}
+
+		using TestPlan = std::vector<std::pair<std::string, std::vector<Test*>>>;
+
+		// Suites stay whole so each is set up and torn down once. Tests
+		// move within their suite, and suites move by their most
+		// promising test. Ties keep the registration order, so without
+		// any history nothing moves.
+		TestPlan prioritize_tests(std::map<HistoryKey, TestHistory> const& history)
+		{
+			struct Ranked
+			{
+				double priority{};
+				std::int64_t cost{};
+			};
+
+			auto rank = [&history](Test const* test)
+			{
+				auto found = history.find(history_key(test));
+				TestHistory const* entry = found == history.end() ? nullptr : &found->second;
+				return Ranked{ history_priority(entry), entry == nullptr ? 0 : entry->average_ns };
+			};
+
+			auto before = [](Ranked const& a, Ranked const& b)
+			{
+				return a.priority > b.priority || (a.priority == b.priority && a.cost < b.cost);
+			};
+
+			TestPlan plan;
+			std::vector<Ranked> suite_ranks;
+			for (auto const& [key, value]: get_tests())
+			{
+				std::vector<std::pair<Ranked, Test*>> ranked;
+				Ranked suite_rank;
+				for (auto* test: value)
+				{
+					ranked.emplace_back(rank(test), test);
+					suite_rank.priority = std::max(suite_rank.priority, ranked.back().first.priority);
+					suite_rank.cost += ranked.back().first.cost;
+				}
+				std::stable_sort(ranked.begin(), ranked.end(), [&before](auto const& a, auto const& b)
+				{
+					return before(a.first, b.first);
+				});
+
+				std::vector<Test*> tests;
+				for (auto const& entry: ranked)
+				{
+					tests.push_back(entry.second);
+				}
+				plan.emplace_back(key, std::move(tests));
+				suite_ranks.push_back(suite_rank);
+			}
+
+			std::vector<std::size_t> order(plan.size());
+			for (std::size_t i = 0; i < order.size(); ++i)
+			{
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+			{
+				return before(suite_ranks[a], suite_ranks[b]);
+			});
+
+			TestPlan ordered;
+			for (auto index: order)
+			{
+				ordered.push_back(std::move(plan[index]));
+			}
+			return ordered;
+		}
+
+		bool is_selected(Test const* test)
+		{
+			std::string const& filter = get_run_options().filter;
+			return filter.empty() || test->name().find(filter) != std::string_view::npos
+				   || test->suite_name().find(filter) != std::string_view::npos;
+		}
+
+		// Drops tests the filter leaves out, and suites left empty, so
+		// their fixtures are never set up.
+		void select_tests(TestPlan& plan)
+		{
+			for (auto& [key, value]: plan)
+			{
+				std::erase_if(value, [](Test const* test)
+				{
+					return !is_selected(test);
+				});
+			}
+			std::erase_if(plan, [](auto const& entry)
+			{
+				return entry.second.empty();
+			});
+		}
+
+		void retain_fixtures(std::string const& key, int count)
+		{
+			auto suites = get_test_suites().find(key);
+			if (suites == get_test_suites().end())
+			{
+				return;
+			}
+			for (auto* suite: suites->second)
+			{
+				suite->retain(count);
+			}
+		}
+
+		void release_fixtures(std::string const& key, int count)
+		{
+			auto suites = get_test_suites().find(key);
+			if (suites == get_test_suites().end())
+			{
+				return;
+			}
+			for (auto* suite: suites->second)
+			{
+				suite->release(count);
+			}
+		}
+
+		std::string format_number(double value)
+		{
+			char buffer[32];
+			std::snprintf(buffer, sizeof(buffer), "%.1f", value);
+			return buffer;
+		}
+
+		void report_checks(std::ostream& output, TestBase const* test)
+		{
+			auto const& stats = test->check_stats();
+			auto& totals = get_check_totals();
+			totals.checks += stats.checks;
+			totals.body_ns += stats.body_ns;
+			for (auto const& site: stats.sites)
+			{
+				auto& total = totals.sites[{ site.file, site.line }];
+				total.file = site.file;
+				total.line = site.line;
+				total.checks += site.checks;
+				total.ns += site.ns;
+			}
+
+			auto const& options = get_run_options();
+			if ((!options.checks && !options.confirm_profile) || stats.checks == 0)
+			{
+				return;
+			}
+
+			output << "    Checks: " << stats.checks;
+			if (stats.body_ns > 0)
+			{
+				output << " (" << format_number(static_cast<double>(stats.checks) * 1e9
+											  / static_cast<double>(stats.body_ns)) << " per second)";
+			}
+			output << std::endl;
+		}
+
+		// Totals over the run and, when profiling, the call sites that
+		// took the largest share of test time.
+		void report_check_totals(std::ostream& output)
+		{
+			auto const& options = get_run_options();
+			auto const& totals = get_check_totals();
+			if (!options.checks && !options.confirm_profile)
+			{
+				return;
+			}
+
+			output << "Checks: " << totals.checks;
+			if (totals.body_ns > 0)
+			{
+				output << " in " << format_number(static_cast<double>(totals.body_ns) / 1e6)
+					   << " ms of test bodies (" << format_number(static_cast<double>(totals.checks) * 1e9
+																 / static_cast<double>(totals.body_ns))
+					   << " per second)";
+			}
+			output << '\n';
+
+			if (options.confirm_profile && !totals.sites.empty())
+			{
+				std::vector<ConfirmSite const*> sites;
+				for (auto const& [key, site]: totals.sites)
+				{
+					sites.push_back(&site);
+				}
+				std::sort(sites.begin(), sites.end(), [](ConfirmSite const* a, ConfirmSite const* b)
+				{
+					return a->ns > b->ns || (a->ns == b->ns && a->checks > b->checks);
+				});
+
+				constexpr std::size_t max_sites = 10;
+				output << "Confirm profile, top " << std::min(max_sites, sites.size()) << " sites by time:\n";
+				for (std::size_t i = 0; i < sites.size() && i < max_sites; ++i)
+				{
+					auto const* site = sites[i];
+					double share = totals.body_ns > 0
+								   ? 100 * static_cast<double>(site->ns) / static_cast<double>(totals.body_ns) : 0;
+					output << "    " << format_number(static_cast<double>(site->ns) / 1e3) << " us ("
+						   << format_number(share) << "% of test time), "
+						   << site->checks << (site->checks == 1 ? " check, " : " checks, ")
+						   << site->file << ':' << site->line << '\n';
+				}
+			}
+			output.flush();
+		}
+
+		void report_arena_usage(std::ostream& output, TestBase const* test)
+		{
+			auto const& usage = test->arena_usage();
+			if (usage.allocations == 0)
+			{
+				return;
+			}
+
+			output << "    Arena: " << usage.allocations
+				   << " allocations, " << usage.bytes_allocated
+				   << " bytes, " << usage.bytes_reserved
+				   << " bytes reserved from the heap"
+				   << std::endl;
+		}
+
+		void apply_resource_limits(ResourceLimits const& limits)
+		{
+#ifdef MERETDD_HAS_POSIX
+			if (limits.address_space != 0)
+			{
+				rlimit limit{ limits.address_space, limits.address_space };
+				setrlimit(RLIMIT_AS, &limit);
+			}
+			if (limits.cpu_seconds != 0)
+			{
+				// SIGXCPU at the soft limit, SIGKILL a second later
+				// in case the test ignores it.
+				rlimit limit{ limits.cpu_seconds, limits.cpu_seconds + 1 };
+				setrlimit(RLIMIT_CPU, &limit);
+			}
+			if (limits.open_files != 0)
+			{
+				rlimit limit{ limits.open_files, limits.open_files };
+				setrlimit(RLIMIT_NOFILE, &limit);
+			}
+#endif
+		}
+
+		void execute_test(Test* test)
+		{
+			Test* outer_test = std::exchange(get_current_test(), test);
+			get_test_clock().reset();
+			get_confirm_counter().store(0, std::memory_order_relaxed);
+			get_confirm_profiling() = get_run_options().confirm_profile;
+			get_test_confirm_sites().clear();
+
+			bool counting = get_run_options().perf_counters && get_perf_counters().available();
+			bool measuring = get_run_options().memory_usage;
+			MemorySample memory_before;
+			if (measuring)
+			{
+				get_fixture_leaked_bytes() = 0;
+				memory_before = sample_memory();
+			}
+
+			// Only the body is timed, not the memory sample or the
+			// counters around it.
+			std::chrono::steady_clock::time_point body_start;
+			try
+			{
+				if (counting)
+				{
+					get_perf_counters().start();
+				}
+				body_start = std::chrono::steady_clock::now();
+				test->run_ex();
+			}
+			catch (const ConfirmException& ex)
+			{
+				test->set_failed(ex.reason(), ex.line());
+			}
+			catch (const MissingException& ex)
+			{
+				std::string message = "Expected exception type ";
+				message += ex.ex_type();
+				message += " was not thrown.";
+				test->set_failed(message);
+			}
+			catch (const std::bad_alloc&)
+			{
+				if (test->resource_limits().address_space != 0)
+				{
+					test->set_limit_exceeded(ResourceLimit::address_space,
+							limit_reason(ResourceLimit::address_space, test->resource_limits()));
+				}
+				else
+				{
+					test->set_failed("Unexpected exception thrown.");
+				}
+			}
+			catch (const std::system_error& ex)
+			{
+				if (test->resource_limits().open_files != 0 && ex.code() == std::errc::too_many_files_open)
+				{
+					test->set_limit_exceeded(ResourceLimit::open_files,
+							limit_reason(ResourceLimit::open_files, test->resource_limits()));
+				}
+				else
+				{
+					test->set_failed("Unexpected exception thrown.");
+				}
+			}
+			catch (...)
+			{
+				test->set_failed("Unexpected exception thrown.");
+			}
+			auto body_end = std::chrono::steady_clock::now();
+
+			if (counting)
+			{
+				test->set_perf_counts(get_perf_counters().stop());
+			}
+
+			CheckStats checks;
+			checks.checks = get_confirm_counter().load(std::memory_order_relaxed);
+			checks.body_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(body_end - body_start).count();
+			for (auto const& [key, site]: get_test_confirm_sites())
+			{
+				checks.sites.push_back(site);
+			}
+			test->set_check_stats(std::move(checks));
+
+			test->set_arena_usage(get_test_arena().usage());
+			get_test_arena().reset();
+
+			if (measuring)
+			{
+				auto usage = measure_memory(memory_before, sample_memory());
+				usage.leaked_heap = get_fixture_leaked_bytes();
+				test->set_memory_usage(usage);
+			}
+			get_current_test() = outer_test;
+		}
+
+#ifdef MERETDD_HAS_POSIX
+		void write_all(int fd, std::string_view data)
+		{
+			while (!data.empty())
+			{
+				ssize_t written = write(fd, data.data(), data.size());
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					return;
+				}
+				data.remove_prefix(static_cast<std::size_t>(written));
+			}
+		}
+
+		std::string read_all(int fd)
+		{
+			std::string data;
+			char buffer[4096];
+			while (true)
+			{
+				ssize_t count = read(fd, buffer, sizeof(buffer));
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (count <= 0)
+				{
+					break;
+				}
+				data.append(buffer, static_cast<std::size_t>(count));
+			}
+			return data;
+		}
+#endif
+
+		// Runs the test in a forked child so a crash or a resource limit
+		// only takes down that child. Suite fixtures set up by the runner
+		// are inherited by the child.
+		void execute_isolated(std::ostream& output, Test* test, ResourceLimits const& limits)
+		{
+#ifdef MERETDD_HAS_POSIX
+			output.flush();
+			std::fflush(nullptr);
+
+			int fds[2];
+			if (pipe(fds) != 0)
+			{
+				execute_test(test);
+				return;
+			}
+
+			pid_t pid = fork();
+			if (pid == -1)
+			{
+				close(fds[0]);
+				close(fds[1]);
+				execute_test(test);
+				return;
+			}
+
+			if (pid == 0)
+			{
+				close(fds[0]);
+				is_isolated_child() = true;
+				if (get_run_options().perf_counters)
+				{
+					get_perf_counters().reopen();
+				}
+				test->limit_resources(limits);
+				execute_test(test);
+
+				RecordWriter record;
+				write_result(record, test);
+				write_all(fds[1], record.data());
+				close(fds[1]);
+
+				output.flush();
+				std::fflush(nullptr);
+				_exit(0);
+			}
+
+			close(fds[1]);
+			std::string data = read_all(fds[0]);
+			close(fds[0]);
+
+			int status = 0;
+			rusage usage{};
+			while (wait4(pid, &status, 0, &usage) == -1 && errno == EINTR)
+			{
+			}
+
+			RecordReader record(data);
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && read_result(record, test))
+			{
+				return;
+			}
+
+			if (WIFSIGNALED(status))
+			{
+				int signal = WTERMSIG(status);
+				auto cpu_seconds = static_cast<std::uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec);
+				if (signal == SIGXCPU || (signal == SIGKILL && limits.cpu_seconds != 0 && cpu_seconds >= limits.cpu_seconds))
+				{
+					test->set_limit_exceeded(ResourceLimit::cpu_time, limit_reason(ResourceLimit::cpu_time, limits));
+					return;
+				}
+
+				test->set_failed("Test process terminated by signal " + std::to_string(signal) + ".");
+				return;
+			}
+
+			test->set_failed("Test process exited with status " + std::to_string(WEXITSTATUS(status)) + ".");
+#else
+			static_cast<void>(output);
+			static_cast<void>(limits);
+			execute_test(test);
+#endif
+		}
+
+		void execute(std::ostream& output, Test* test)
+		{
+			ResourceLimits limits = effective_limits(test);
+			if (get_run_options().isolate || has_limits(limits))
+			{
+				execute_isolated(output, test, limits);
+			}
+			else
+			{
+				execute_test(test);
+			}
+		}
+
+		// Writes the outcome of a test that has already run and counts it.
+		void report_test_result(std::ostream& output, Test const* test,
+				int& num_passed, int& num_failed, int& num_missed_failed)
+		{
+			if (test->passed())
+			{
+				if (!test->expected_reason().empty())
+				{
+					// This test passed, but it was supposed
+					// to have failed.
+					++num_missed_failed;
+					output << "Missed expected failure\n"
+						   << "Test passed but was expected to fail."
+						   << std::endl;
+				}
+				else
+				{
+					++num_passed;
+					output << "Passed" << std::endl;
+				}
+			}
+			else if (!test->expected_reason().empty() && test->expected_reason() == test->reason())
+			{
+				++num_passed;
+				output << "Expected failure\n"
+					   << test->reason()
+					   << std::endl;
+			}
+			else if (test->limit_exceeded() != ResourceLimit::none)
+			{
+				++num_failed;
+				output << "Failed resource limit\n"
+					   << test->reason()
+					   << std::endl;
+			}
+			else
+			{
+				++num_failed;
+				if (test->confirm_location() != -1)
+				{
+					output << "Failed confirm on line "
+						   << test->confirm_location() << '\n';
+				}
+				else
+				{
+					output << "Failed\n";
+				}
+
+				output << test->reason() << std::endl;
+			}
+
+			report_perf_counts(output, test);
+			report_memory_usage(output, test, "SetupAndTeardown");
+			report_arena_usage(output, test);
+			report_checks(output, test);
+		}
+	}
+
+	void TestBase::limit_resources(ResourceLimits const& limits)
+	{
+		if (!is_isolated_child())
+		{
+			return;
+		}
+
+		// Only ever tighten: a zero keeps whatever is already in place.
+		auto tighten = [](std::uint64_t& current, std::uint64_t requested)
+		{
+			if (requested != 0 && (current == 0 || requested < current))
+			{
+				current = requested;
+			}
+		};
+		tighten(m_resource_limits.address_space, limits.address_space);
+		tighten(m_resource_limits.cpu_seconds, limits.cpu_seconds);
+		tighten(m_resource_limits.open_files, limits.open_files);
+		apply_resource_limits(m_resource_limits);
+	}
+
+	void confirm_snapshot(std::string_view name, std::string_view actual, const std::source_location location)
+	{
+		count_confirm(location);
+		auto path = snapshot_path(name, location);
+		// A test that expects to fail compares as usual, so its wrong
+		// value never becomes the golden.
+		Test const* test = get_current_test();
+		bool expects_failure = test != nullptr && !test->expected_reason().empty();
+		if (get_run_options().update_snapshots && !expects_failure)
+		{
+			{
+				MappedFile golden(path);
+				if (golden.exists() && golden.contents() == actual)
+				{
+					return;
+				}
+			}
+
+			std::error_code error;
+			std::filesystem::create_directories(path.parent_path(), error);
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(actual.data(), static_cast<std::streamsize>(actual.size()));
+			if (!file)
+			{
+				throw SnapshotConfirmException("    Unable to write snapshot file " + path.string(), static_cast<int>(location.line()));
+			}
+			return;
+		}
+
+		MappedFile golden(path);
+		if (!golden.exists())
+		{
+			throw SnapshotConfirmException("    Snapshot file " + path.string() + " does not exist.\n"
+										   "    Run with --update-snapshots to create it.", static_cast<int>(location.line()));
+		}
+
+		auto expected = golden.contents();
+		if (expected.size() == actual.size() && std::memcmp(expected.data(), actual.data(), actual.size()) == 0)
+		{
+			return;
+		}
+
+		std::string reason = "    Snapshot " + std::string(name) + " differs from " + path.string() + '\n';
+		reason += describe_text_difference(expected, actual);
+		reason.pop_back();
+		throw SnapshotConfirmException(std::move(reason), static_cast<int>(location.line()));
+	}
+
+	void throw_string_mismatch(std::string_view expected, std::string_view actual, int line)
+	{
+		if (expected.size() <= mismatch_window && actual.size() <= mismatch_window)
+		{
+			throw ActualConfirmException(expected, actual, line);
+		}
+
+		std::size_t offset = first_difference(expected, actual);
+		std::size_t start = offset > mismatch_window ? offset - mismatch_window : 0;
+		auto append_excerpt = [&](std::string& output, std::string_view text)
+		{
+			std::size_t stop = std::min(text.size(), offset + mismatch_window);
+			output += start > 0 ? "...\"" : "\"";
+			append_escaped(output, text.substr(start, stop - start));
+			output += stop < text.size() ? "\"..." : "\"";
+		};
+
+		std::string reason = "    Mismatch at offset " + std::to_string(offset)
+							 + " (expected length " + std::to_string(expected.size())
+							 + ", actual length " + std::to_string(actual.size()) + ")\n";
+		reason += "    Expected: ";
+		append_excerpt(reason, expected);
+		reason += "\n    Actual  : ";
+		append_excerpt(reason, actual);
+		throw MismatchConfirmException(std::move(reason), line);
+	}
+
+	void throw_container_mismatch(std::size_t index, std::size_t expected_size, std::size_t actual_size,
+			std::size_t window_start, std::vector<std::string> const& expected_window,
+			std::vector<std::string> const& actual_window, int line)
+	{
+		auto append_window = [&](std::string& output, std::vector<std::string> const& elements, std::size_t size)
+		{
+			output += window_start > 0 ? "[..., " : "[";
+			for (std::size_t i = 0; i < elements.size(); ++i)
+			{
+				output += i == 0 ? "" : ", ";
+				output += elements[i];
+			}
+			output += window_start + elements.size() < size ? ", ...]" : "]";
+		};
+
+		std::string reason = "    Mismatch at index " + std::to_string(index)
+							 + " (expected size " + std::to_string(expected_size)
+							 + ", actual size " + std::to_string(actual_size) + ")\n";
+		reason += "    Expected: ";
+		append_window(reason, expected_window, expected_size);
+		reason += "\n    Actual  : ";
+		append_window(reason, actual_window, actual_size);
+		throw MismatchConfirmException(std::move(reason), line);
+	}
+
+	std::vector<int> parse_cpu_list(std::string_view text)
+	{
+#ifdef __linux__
+		constexpr int max_cpus = CPU_SETSIZE;
+#else
+		constexpr int max_cpus = 1024;
+#endif
+		std::vector<int> cpus;
+		while (!text.empty())
+		{
+			auto comma = text.find(',');
+			std::string range(text.substr(0, comma));
+			text.remove_prefix(comma == std::string_view::npos ? text.size() : comma + 1);
+
+			auto dash = range.find('-');
+			int first = std::atoi(range.c_str());
+			int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+			if (first < 0 || last < first || last >= max_cpus)
+			{
+				return {};
+			}
+			for (int cpu = first; cpu <= last; ++cpu)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+
+	namespace
+	{
+		std::int64_t read_cpu_counter(std::string_view name, int cpu)
+		{
+#ifdef __linux__
+			std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/" + std::string(name));
+			std::int64_t value = 0;
+			if (file >> value)
+			{
+				return value;
+			}
+#else
+			static_cast<void>(name);
+			static_cast<void>(cpu);
+#endif
+			return 0;
+		}
+
+		// The mean over the CPUs that report one, since the benchmark
+		// may move between them.
+		std::int64_t read_cpu_frequency(std::vector<int> const& cpus)
+		{
+			std::int64_t total = 0;
+			std::int64_t reported = 0;
+			for (int cpu: cpus)
+			{
+				std::int64_t khz = read_cpu_counter("cpufreq/scaling_cur_freq", cpu);
+				if (khz != 0)
+				{
+					total += khz;
+					++reported;
+				}
+			}
+			return reported == 0 ? 0 : total / reported;
+		}
+
+		std::int64_t read_throttle_count(std::vector<int> const& cpus)
+		{
+			std::int64_t total = 0;
+			for (int cpu: cpus)
+			{
+				total += read_cpu_counter("thermal_throttle/core_throttle_count", cpu);
+			}
+			return total;
+		}
+
+		// Pins the runner to the requested CPUs and raises its priority
+		// for the duration of the benchmark run.
+		class BenchmarkEnvironment
+		{
+		public:
+			BenchmarkEnvironment(std::ostream& output, RunOptions const& options)
+			{
+#ifdef __linux__
+				if (!options.benchmark_cpus.empty())
+				{
+					cpu_set_t cpus;
+					CPU_ZERO(&cpus);
+					for (int cpu: parse_cpu_list(options.benchmark_cpus))
+					{
+						if (cpu >= 0 && cpu < CPU_SETSIZE)
+						{
+							CPU_SET(cpu, &cpus);
+						}
+					}
+
+					if (sched_getaffinity(0, sizeof(m_previous_cpus), &m_previous_cpus) == 0
+						&& sched_setaffinity(0, sizeof(cpus), &cpus) == 0)
+					{
+						m_pinned = true;
+						output << "Pinned to CPUs " << options.benchmark_cpus << '\n';
+					}
+					else
+					{
+						output << "Unable to pin to CPUs " << options.benchmark_cpus << '\n';
+					}
+				}
+
+				cpu_set_t allowed;
+				if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+				{
+					for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+					{
+						if (CPU_ISSET(cpu, &allowed))
+						{
+							m_cpus.push_back(cpu);
+						}
+					}
+				}
+
+				if (options.benchmark_priority)
+				{
+					errno = 0;
+					m_previous_nice = getpriority(PRIO_PROCESS, 0);
+					if (errno == 0 && setpriority(PRIO_PROCESS, 0, -20) == 0)
+					{
+						m_prioritized = true;
+						output << "Raised scheduling priority\n";
+					}
+					else
+					{
+						output << "Unable to raise scheduling priority\n";
+					}
+				}
+#else
+				if (!options.benchmark_cpus.empty() || options.benchmark_priority)
+				{
+					output << "CPU pinning and priority are only supported on Linux\n";
+				}
+#endif
+			}
+
+			BenchmarkEnvironment(BenchmarkEnvironment const&) = delete;
+
+			BenchmarkEnvironment& operator=(BenchmarkEnvironment const&) = delete;
+
+			// The CPUs the runner may run on: the pinned ones, or all it
+			// was allowed when not pinned.
+			std::vector<int> const& cpus() const
+			{
+				return m_cpus;
+			}
+
+			~BenchmarkEnvironment()
+			{
+#ifdef __linux__
+				if (m_prioritized)
+				{
+					setpriority(PRIO_PROCESS, 0, m_previous_nice);
+				}
+				if (m_pinned)
+				{
+					sched_setaffinity(0, sizeof(m_previous_cpus), &m_previous_cpus);
+				}
+#endif
+			}
+
+		private:
+#ifdef __linux__
+			cpu_set_t m_previous_cpus{};
+			int m_previous_nice{};
+#endif
+			std::vector<int> m_cpus;
+			bool m_pinned{ false };
+			bool m_prioritized{ false };
+		};
+
+		// Nanoseconds per iteration over one batch.
+		double time_iterations(Benchmark* benchmark, std::size_t iterations)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < iterations; ++i)
+			{
+				benchmark->run_ex();
+			}
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			get_test_arena().reset();
+			return elapsed.count() / static_cast<double>(iterations);
+		}
+
+		// A fixed amount of integer work. Comparing it before and after
+		// the samples shows whether the CPU changed speed in between.
+		// The fastest of a few runs is used to keep scheduler noise out.
+		double time_calibration()
+		{
+			double fastest = 0;
+			for (int run = 0; run < 3; ++run)
+			{
+				auto start = std::chrono::steady_clock::now();
+				std::uint64_t value = 1;
+				for (int i = 0; i < (1 << 20); ++i)
+				{
+					value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+					do_not_optimize(value);
+				}
+				std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+				fastest = run == 0 ? elapsed.count() : std::min(fastest, elapsed.count());
+			}
+			return fastest;
+		}
+	}
+
+	double coefficient_of_variation(std::vector<double> const& values)
+	{
+		double mean = 0;
+		for (double value: values)
+		{
+			mean += value;
+		}
+		mean /= static_cast<double>(values.size());
+
+		double variance = 0;
+		for (double value: values)
+		{
+			variance += (value - mean) * (value - mean);
+		}
+		variance /= static_cast<double>(values.size());
+		return mean == 0 ? 0 : std::sqrt(variance) / mean;
+	}
+
+	BenchmarkResult measure_benchmark(Benchmark* benchmark, int samples, std::vector<int> const& cpus)
+	{
+		using namespace std::chrono_literals;
+		constexpr auto sample_time = 10ms;
+		constexpr auto max_warmup = 2s;
+		constexpr std::size_t settle_window = 5;
+		constexpr double settled_variation = 0.02;
+
+		BenchmarkResult result;
+		double single = std::max(time_iterations(benchmark, 1), 1.0);
+		double batch = std::chrono::duration<double, std::nano>(sample_time).count() / single;
+		result.iterations = static_cast<std::size_t>(std::clamp(batch, 1.0, 1e9));
+
+		// Warm up until the last few samples agree with each other.
+		std::vector<double> recent;
+		auto warmup_start = std::chrono::steady_clock::now();
+		while (true)
+		{
+			recent.push_back(time_iterations(benchmark, result.iterations));
+			++result.warmup_samples;
+			if (recent.size() > settle_window)
+			{
+				recent.erase(recent.begin());
+			}
+			if (recent.size() == settle_window && coefficient_of_variation(recent) < settled_variation)
+			{
+				break;
+			}
+			if (std::chrono::steady_clock::now() - warmup_start > max_warmup)
+			{
+				break;
+			}
+		}
+
+		double calibration_before = time_calibration();
+		result.frequency_before_khz = read_cpu_frequency(cpus);
+		std::int64_t throttle_before = read_throttle_count(cpus);
+
+		bool counting = get_run_options().perf_counters && get_perf_counters().available();
+		if (counting)
+		{
+			get_perf_counters().start();
+		}
+
+		std::vector<double> times;
+		for (int i = 0; i < samples; ++i)
+		{
+			times.push_back(time_iterations(benchmark, result.iterations));
+		}
+
+		if (counting)
+		{
+			benchmark->set_perf_counts(get_perf_counters().stop());
+		}
+
+		result.throttle_events = read_throttle_count(cpus) - throttle_before;
+		result.frequency_after_khz = read_cpu_frequency(cpus);
+		double calibration_after = time_calibration();
+		result.calibration_drift = (calibration_after - calibration_before) / calibration_before;
+
+		std::sort(times.begin(), times.end());
+		result.samples = times.size();
+		result.min_ns = times.front();
+		result.median_ns = times.size() % 2 == 1
+						   ? times[times.size() / 2]
+						   : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+		for (double time: times)
+		{
+			result.mean_ns += time;
+		}
+		result.mean_ns /= static_cast<double>(times.size());
+		result.stddev_ns = coefficient_of_variation(times) * result.mean_ns;
+		return result;
+	}
+
+	void report_benchmark(std::ostream& output, Benchmark const* benchmark)
+	{
+		auto const& result = benchmark->result();
+		output << "    " << format_number(result.median_ns) << " ns per iteration (median of "
+			   << result.samples << " samples x " << result.iterations << " iterations)\n"
+			   << "    mean " << format_number(result.mean_ns)
+			   << " ns, stddev " << format_number(result.stddev_ns)
+			   << " ns (" << format_number(result.mean_ns == 0 ? 0 : 100 * result.stddev_ns / result.mean_ns)
+			   << "%), min " << format_number(result.min_ns) << " ns\n"
+			   << "    Warm-up: " << result.warmup_samples << " samples\n";
+
+		if (!benchmark->perf_counts().empty())
+		{
+			auto total = static_cast<double>(result.samples * result.iterations);
+			output << "    Counters per iteration:";
+			for (auto const& count: benchmark->perf_counts())
+			{
+				output << ' ' << count.name << '=' << format_number(static_cast<double>(count.value) / total);
+			}
+			output << '\n';
+		}
+
+		if (result.frequency_before_khz != 0)
+		{
+			output << "    Frequency: " << result.frequency_before_khz << " -> "
+				   << result.frequency_after_khz << " kHz\n";
+		}
+
+		constexpr double max_drift = 0.05;
+		if (std::abs(result.calibration_drift) > max_drift)
+		{
+			output << "    Warning: calibration loop changed by "
+				   << format_number(100 * result.calibration_drift)
+				   << "% while sampling; results may not reproduce\n";
+		}
+		if (result.frequency_before_khz != 0 && std::abs(static_cast<double>(result.frequency_after_khz
+																			  - result.frequency_before_khz))
+												> max_drift * static_cast<double>(result.frequency_before_khz))
+		{
+			output << "    Warning: CPU frequency changed while sampling\n";
+		}
+		if (result.throttle_events > 0)
+		{
+			output << "    Warning: CPU was thermally throttled "
+				   << result.throttle_events << " times while sampling\n";
+		}
+		output.flush();
+	}
+
+	void add_benchmark(Benchmark* benchmark)
+	{
+		get_benchmarks().push_back(benchmark);
+	}
+
+	void remove_benchmark(Benchmark* benchmark)
+	{
+		std::erase(get_benchmarks(), benchmark);
+	}
+
+	int run_benchmarks(std::ostream& output)
+	{
+		output << "Running "
+			   << get_benchmarks().size()
+			   << " benchmarks\n";
+
+		BenchmarkEnvironment environment(output, get_run_options());
+		int samples = std::max(1, get_run_options().benchmark_samples);
+
+		int num_run = 0;
+		int num_failed = 0;
+		for (auto* benchmark: get_benchmarks())
+		{
+			if (get_cancellation_token().cancelled())
+			{
+				break;
+			}
+
+			output << "------- Benchmark: "
+				   << benchmark->name()
+				   << std::endl;
+
+			try
+			{
+				benchmark->set_result(measure_benchmark(benchmark, samples, environment.cpus()));
+			}
+			catch (const ConfirmException& ex)
+			{
+				benchmark->set_failed(ex.reason(), ex.line());
+			}
+			catch (...)
+			{
+				benchmark->set_failed("Unexpected exception thrown.");
+			}
+
+			++num_run;
+			if (benchmark->passed())
+			{
+				report_benchmark(output, benchmark);
+				continue;
+			}
+
+			++num_failed;
+			if (benchmark->confirm_location() != -1)
+			{
+				output << "Failed confirm on line "
+					   << benchmark->confirm_location() << '\n';
+			}
+			else
+			{
+				output << "Failed\n";
+			}
+			output << benchmark->reason() << std::endl;
+		}
+
+		output << "-----------------------------------\n"
+			   << "Benchmarks run: " << num_run
+			   << "\nBenchmarks failed: " << num_failed
+			   << std::endl;
+
+		return num_failed;
+	}
+
+	Clock::TimerId Clock::schedule(duration delay, std::function<void()> callback)
+	{
+		TimerId id = m_next_id++;
+		m_timers.push_back({ id, now() + delay, std::move(callback) });
+		return id;
+	}
+
+	void Clock::cancel(TimerId id)
+	{
+		std::erase_if(m_timers, [id](Timer const& timer)
+		{
+			return timer.id == id;
+		});
+	}
+
+	bool Clock::next_due(time_point& due) const
+	{
+		auto next = std::min_element(m_timers.begin(), m_timers.end(), [](Timer const& a, Timer const& b)
+		{
+			return a.due < b.due || (a.due == b.due && a.id < b.id);
+		});
+		if (next == m_timers.end())
+		{
+			return false;
+		}
+		due = next->due;
+		return true;
+	}
+
+	bool Clock::pop_due_timer(time_point limit, time_point& due, std::function<void()>& callback)
+	{
+		auto next = std::min_element(m_timers.begin(), m_timers.end(), [](Timer const& a, Timer const& b)
+		{
+			return a.due < b.due || (a.due == b.due && a.id < b.id);
+		});
+		if (next == m_timers.end() || next->due > limit)
+		{
+			return false;
+		}
+		due = next->due;
+		callback = std::move(next->callback);
+		m_timers.erase(next);
+		return true;
+	}
+
+	VirtualClock& get_test_clock()
+	{
+		static VirtualClock clock;
+
+		return clock;
+	}
+
+	Clock::time_point SystemClock::now() const
+	{
+		return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+	}
+
+	void SystemClock::sleep_for(duration delay)
+	{
+		time_point target = now() + delay;
+		time_point due;
+		std::function<void()> callback;
+		while (next_due(due) && due <= target)
+		{
+			std::this_thread::sleep_for(due - now());
+			if (pop_due_timer(due, due, callback))
+			{
+				callback();
+			}
+		}
+		std::this_thread::sleep_for(target - now());
+	}
+
+	void VirtualClock::advance(duration delay)
+	{
+		time_point target = m_now + delay;
+		time_point due;
+		std::function<void()> callback;
+		while (pop_due_timer(target, due, callback))
+		{
+			m_now = std::max(m_now, due);
+			callback();
+		}
+		m_now = std::max(m_now, target);
+	}
+
+	void FuzzTest::run()
+	{
+		auto directory = corpus_path(this);
+		std::vector<std::filesystem::path> inputs;
+		std::error_code error;
+		for (auto const& entry: std::filesystem::directory_iterator(directory, error))
+		{
+			if (entry.is_regular_file())
+			{
+				inputs.push_back(entry.path());
+			}
+		}
+		std::sort(inputs.begin(), inputs.end());
+
+		if (inputs.empty())
+		{
+			// Without seeds the body still runs once on empty input.
+			static constexpr std::uint8_t empty[1]{};
+			run_input(empty, 0);
+			return;
+		}
+
+		for (auto const& input: inputs)
+		{
+			if (cancellation_requested())
+			{
+				return;
+			}
+
+			MappedFile file(input);
+			auto contents = file.contents();
+			try
+			{
+				run_input(reinterpret_cast<const std::uint8_t*>(contents.data()), contents.size());
+			}
+			catch (const ConfirmException& ex)
+			{
+				throw CorpusConfirmException("    Corpus input: " + input.string() + '\n' + std::string(ex.reason()),
+						ex.line());
+			}
+			catch (...)
+			{
+				throw CorpusConfirmException("    Corpus input: " + input.string() + "\n    Unexpected exception thrown.",
+						-1);
+			}
+		}
+	}
+
+	void set_suite_resource_limits(std::string_view suite_name, ResourceLimits const& limits)
+	{
+		get_suite_resource_limits()[std::string(suite_name)] = limits;
+	}
+
+	RunOptions& get_run_options()
+	{
+		static RunOptions options;
+
+		return options;
+	}
+
+	void parse_options(int argc, char* argv[])
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string_view arg(argv[i]);
+			if (arg == "--perf-counters")
+			{
+				get_run_options().perf_counters = true;
+			}
+			else if (arg == "--memory-usage")
+			{
+				get_run_options().memory_usage = true;
+			}
+			else if (arg == "--list")
+			{
+				get_run_options().list = ListMode::human;
+			}
+			else if (arg == "--list=json")
+			{
+				get_run_options().list = ListMode::json;
+			}
+			else if (arg == "--isolate")
+			{
+				get_run_options().isolate = true;
+			}
+			else if (arg.starts_with("--limit-memory="))
+			{
+				// Given in MiB of address space.
+				get_run_options().limits.address_space = std::strtoull(argv[i] + arg.find('=') + 1, nullptr, 10) << 20;
+			}
+			else if (arg.starts_with("--limit-cpu="))
+			{
+				get_run_options().limits.cpu_seconds = std::strtoull(argv[i] + arg.find('=') + 1, nullptr, 10);
+			}
+			else if (arg.starts_with("--limit-files="))
+			{
+				get_run_options().limits.open_files = std::strtoull(argv[i] + arg.find('=') + 1, nullptr, 10);
+			}
+			else if (arg == "--update-snapshots")
+			{
+				get_run_options().update_snapshots = true;
+			}
+			else if (arg.starts_with("--snapshot-dir="))
+			{
+				get_run_options().snapshot_dir = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg.starts_with("--corpus-dir="))
+			{
+				get_run_options().corpus_dir = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg == "--benchmark")
+			{
+				get_run_options().benchmark = true;
+			}
+			else if (arg.starts_with("--cpus="))
+			{
+				get_run_options().benchmark_cpus = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg == "--benchmark-priority")
+			{
+				get_run_options().benchmark_priority = true;
+			}
+			else if (arg.starts_with("--benchmark-samples="))
+			{
+				get_run_options().benchmark_samples = std::atoi(argv[i] + arg.find('=') + 1);
+			}
+			else if (arg.starts_with("--history="))
+			{
+				get_run_options().history_file = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg.starts_with("--summary="))
+			{
+				get_run_options().summary_file = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg == "--checks")
+			{
+				get_run_options().checks = true;
+			}
+			else if (arg == "--confirm-profile")
+			{
+				get_run_options().confirm_profile = true;
+			}
+			else if (arg.starts_with("--filter="))
+			{
+				get_run_options().filter = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg.starts_with("--workers="))
+			{
+				get_run_options().workers = std::max(0, std::atoi(argv[i] + arg.find('=') + 1));
+			}
+			else if (arg.starts_with("--listen="))
+			{
+				get_run_options().listen_address = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg.starts_with("--worker="))
+			{
+				get_run_options().worker_address = arg.substr(arg.find('=') + 1);
+			}
+			else if (arg == "--fail-fast")
+			{
+				get_run_options().fail_fast = 1;
+			}
+			else if (arg.starts_with("--fail-fast="))
+			{
+				get_run_options().fail_fast = std::max(1, std::atoi(argv[i] + arg.find('=') + 1));
+			}
+		}
+	}
+
+	MemorySample sample_memory()
+	{
+		MemorySample sample;
+#ifdef __linux__
+		if (FILE* statm = std::fopen("/proc/self/statm", "r"))
+		{
+			long pages = 0;
+			long resident_pages = 0;
+			if (std::fscanf(statm, "%ld %ld", &pages, &resident_pages) == 2)
+			{
+				sample.resident = static_cast<std::int64_t>(resident_pages) * sysconf(_SC_PAGESIZE);
+			}
+			std::fclose(statm);
+		}
+
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) == 0)
+		{
+			// Linux reports the high-water mark in kilobytes.
+			sample.peak_resident = static_cast<std::int64_t>(usage.ru_maxrss) * 1024;
+		}
+#endif
+#ifdef MERETDD_HAS_MALLINFO2
+		auto info = mallinfo2();
+		sample.live_heap = static_cast<std::int64_t>(info.uordblks + info.hblkhd);
+#endif
+		return sample;
+	}
+
+	// The interrupt handler cancels, so the flag has to be lock-free.
+	static_assert(std::atomic_ref<bool>::is_always_lock_free);
+	static_assert(std::atomic_ref<bool>::required_alignment <= alignof(bool));
+
+	bool CancellationToken::cancelled() const
+	{
+		return std::atomic_ref<bool>(const_cast<bool&>(m_cancelled)).load(std::memory_order_relaxed);
+	}
+
+	void CancellationToken::cancel()
+	{
+		std::atomic_ref<bool>(m_cancelled).store(true, std::memory_order_relaxed);
+	}
+
+	void CancellationToken::reset()
+	{
+		std::atomic_ref<bool>(m_cancelled).store(false, std::memory_order_relaxed);
+	}
+
+	CancellationToken& get_cancellation_token()
+	{
+		static CancellationToken token;
+
+		return token;
+	}
+
+	std::uint64_t get_confirm_count()
+	{
+		return get_confirm_counter().load(std::memory_order_relaxed);
+	}
+
+	void count_confirm(std::source_location const& location)
+	{
+		auto& count = get_confirm_counter();
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (get_confirm_profiling())
+		{
+			record_confirm_site(location);
+		}
+	}
+
+	std::int64_t confirm_clock_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void record_confirm_time(std::source_location const& location, std::int64_t elapsed_ns)
+	{
+		auto& site = get_test_confirm_sites()[{ location.file_name(), static_cast<int>(location.line()) }];
+		if (site.file.empty())
+		{
+			site.file = location.file_name();
+			site.line = static_cast<int>(location.line());
+		}
+		site.ns += elapsed_ns;
+	}
+
+	std::int64_t& get_fixture_leaked_bytes()
+	{
+		static std::int64_t leaked = 0;
+
+		return leaked;
+	}
+
+	FixtureLeakCheck::FixtureLeakCheck() :
+			m_enabled(get_run_options().memory_usage),
+			m_uncaught(std::uncaught_exceptions())
+	{
+		if (m_enabled)
+		{
+			m_before = sample_memory();
+			m_arena_before = get_test_arena().usage().bytes_reserved;
+		}
+	}
+
+	FixtureLeakCheck::~FixtureLeakCheck()
+	{
+		// An exception in flight holds heap memory of its own
+		// which would be mistaken for a leak.
+		if (!m_enabled || std::uncaught_exceptions() > m_uncaught)
+		{
+			return;
+		}
+
+		// Blocks the arena grew by are released by the runner.
+		auto arena_growth = get_test_arena().usage().bytes_reserved - m_arena_before;
+		std::int64_t leaked = sample_memory().live_heap - m_before.live_heap
+				- static_cast<std::int64_t>(arena_growth);
+		if (leaked > 0)
+		{
+			get_fixture_leaked_bytes() += leaked;
+		}
+	}
+
+	TestArena::TestArena() :
+			m_upstream(m_usage),
+			m_buffer(m_first_block, sizeof(m_first_block), &m_upstream)
+	{
+	}
+
+	void TestArena::reset()
+	{
+		m_buffer.release();
+		m_usage = {};
+	}
+
+	void* TestArena::do_allocate(std::size_t bytes, std::size_t alignment)
+	{
+		++m_usage.allocations;
+		m_usage.bytes_allocated += bytes;
+		return m_buffer.allocate(bytes, alignment);
+	}
+
+	void* TestArena::Upstream::do_allocate(std::size_t bytes, std::size_t alignment)
+	{
+		void* block = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		m_usage.bytes_reserved += bytes;
+		return block;
+	}
+
+	void TestArena::Upstream::do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+	{
+		std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		m_usage.bytes_reserved -= bytes;
+	}
+
+	TestArena& get_test_arena()
+	{
+		return *get_current_arena();
+	}
+
+	void add_test(std::string_view suite_name, Test* test)
+	{
+		std::string name(suite_name);
+		if (!get_tests().contains(name))
+		{
+			get_tests().try_emplace(name, std::vector<Test*>());
+		}
+
+		get_tests()[name].push_back(test);
+	}
+
+	void add_test_suite(std::string_view suite_name, TestSuite* suite)
+	{
+		std::string name(suite_name);
+		if (!get_test_suites().contains(name))
+		{
+			get_test_suites().try_emplace(name, std::vector<TestSuite*>());
+		}
+		get_test_suites()[name].push_back(suite);
+	}
+
+	void remove_test(std::string_view suite_name, Test* test)
+	{
+		auto suite = get_tests().find(std::string(suite_name));
+		if (suite == get_tests().end())
+		{
+			return;
+		}
+
+		// Searched from the back, since tests are mostly destroyed in
+		// the reverse order of their registration.
+		auto& tests = suite->second;
+		auto found = std::find(tests.rbegin(), tests.rend(), test);
+		if (found != tests.rend())
+		{
+			tests.erase(std::next(found).base());
+		}
+		if (tests.empty())
+		{
+			get_tests().erase(suite);
+		}
+	}
+
+	void remove_test_suite(TestSuite* suite)
+	{
+		// A fixture may serve several suites.
+		auto& suites = get_test_suites();
+		for (auto entry = suites.begin(); entry != suites.end();)
+		{
+			std::erase(entry->second, suite);
+			entry = entry->second.empty() ? suites.erase(entry) : std::next(entry);
+		}
+	}
+
+	void run_test(std::ostream& output, Test* test, int& num_passed, int& num_failed, int& num_missed_failed)
+	{
+		output << "------- Test: "
+			   << test->name()
+			   << std::endl;
+
+		execute(output, test);
+		report_test_result(output, test, num_passed, num_failed, num_missed_failed);
+	}
+
+	bool run_suite(std::ostream& output, bool setup, const std::string& name, int& num_passed, int& num_failed)
+	{
+		for (auto& suite: get_test_suites()[name])
+		{
+			// A fixture shared with other suites may already be set
+			// up, or still be needed by their tests.
+			if (setup ? suite->is_set_up() : (!suite->is_set_up() || suite->users() > 0))
+			{
+				continue;
+			}
+
+			if (setup)
+			{
+				output << "------- Setup: ";
+			}
+			else
+			{
+				output << "------- Teardown: ";
+			}
+			output << suite->name() << std::endl;
+
+			// The resident set is followed from setup to teardown, but
+			// only heap that setup and teardown allocate and free
+			// themselves counts towards a leak.
+			bool measuring = get_run_options().memory_usage;
+			MemorySample before;
+			if (measuring)
+			{
+				before = sample_memory();
+				if (setup)
+				{
+					suite->set_setup_sample(before);
+				}
+			}
+
+			if (setup)
+			{
+				suite->clear_failure();
+			}
+
+			try
+			{
+				if (setup)
+				{
+					suite->suite_setup();
+				}
+				else
+				{
+					suite->suite_teardown();
+				}
+			}
+			catch (const ConfirmException& ex)
+			{
+				suite->set_failed(ex.reason(), ex.line());
+			}
+			catch (...)
+			{
+				suite->set_failed("Unexpected exception thrown.");
+			}
+
+			if (measuring)
+			{
+				MemorySample after = sample_memory();
+				if (setup)
+				{
+					suite->set_setup_heap(after.live_heap - before.live_heap);
+					suite->set_memory_usage({});
+				}
+				else
+				{
+					auto usage = measure_memory(suite->setup_sample(), after);
+					usage.leaked_heap = suite->setup_heap() + after.live_heap - before.live_heap;
+					suite->set_memory_usage(usage);
+				}
+			}
+			suite->set_set_up(setup && suite->passed());
+
+			if (suite->passed())
+			{
+				++num_passed;
+				output << "Passed" << std::endl;
+				report_memory_usage(output, suite, "TestSuiteSetupAndTeardown");
+			}
+			else
+			{
+				++num_failed;
+				if (suite->confirm_location() != -1)
+				{
+					output << "Failed confirm on line "
+						   << suite->confirm_location() << '\n';
+				}
+				else
+				{
+					output << "Failed\n";
+				}
+				output << suite->reason() << std::endl;
+				report_memory_usage(output, suite, "TestSuiteSetupAndTeardown");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int run_tests(std::ostream& output)
+	{
+		output << "Running "
+			   << get_tests().size()
+			   << " tests\n";
+
+		if (get_run_options().perf_counters)
+		{
+			if (!get_perf_counters().available())
+			{
+				output << "Performance counters unavailable.\n";
+			}
+			else if (get_perf_counters().hardware())
+			{
+				output << "Performance counters: hardware\n";
+			}
+			else
+			{
+				output << "Performance counters: software\n";
+			}
+		}
+
+		CheckTotalsScope check_totals;
+		TestStateScope test_state;
+
+		int num_passed = 0;
+		int num_missed_failed = 0;
+		int num_failed = 0;
+		std::size_t num_not_run = 0;
+		int num_over_limit = 0;
+
+		auto& token = get_cancellation_token();
+		token.reset();
+		InterruptCancellation interrupt_cancellation;
+
+		int fail_fast = get_run_options().fail_fast;
+		auto check_fail_fast = [&]()
+		{
+			if (fail_fast > 0 && num_failed >= fail_fast && !token.cancelled())
+			{
+				output << "Stopping after " << num_failed
+					   << (num_failed == 1 ? " failure." : " failures.")
+					   << std::endl;
+				token.cancel();
+			}
+		};
+
+		std::string const& history_file = get_run_options().history_file;
+		std::map<HistoryKey, TestHistory> history;
+		TestPlan plan;
+		if (history_file.empty())
+		{
+			plan.assign(get_tests().begin(), get_tests().end());
+		}
+		else
+		{
+			history = read_history(history_file);
+			plan = prioritize_tests(history);
+			output << "Ordered by history of " << history.size() << " tests\n";
+		}
+
+		// Every fixture counts the selected tests that need it, so it is
+		// set up before the first of them and torn down after the
+		// last, even when it serves several suites.
+		select_tests(plan);
+		for (auto const& [key, value]: plan)
+		{
+			retain_fixtures(key, static_cast<int>(value.size()));
+		}
+
+		auto tear_down = [&](std::string const& key)
+		{
+			if (key.empty())
+			{
+				return;
+			}
+			if (!run_suite(output, false, key, num_passed, num_failed))
+			{
+				output << "Test suite teardown failed." << std::endl;
+			}
+			check_fail_fast();
+		};
+
+		// A suite without a fixture stops the run, but what was set up
+		// is still torn down and the summary still written.
+		bool suite_missing = false;
+		for (auto const& [key, value]: plan)
+		{
+			if (token.cancelled() || suite_missing)
+			{
+				num_not_run += value.size();
+				release_fixtures(key, static_cast<int>(value.size()));
+				tear_down(key);
+				continue;
+			}
+
+			std::string suite_display_name = "Suite: ";
+			if (key.empty())
+			{
+				suite_display_name += "Single Tests";
+			}
+			else
+			{
+				suite_display_name += key;
+			}
+			output << "---------------- " << suite_display_name << std::endl;
+
+			if (!key.empty() && !get_test_suites().contains(key))
+			{
+				output << "Test suite is not found."
+					   << " Exiting test application."
+					   << std::endl;
+				++num_failed;
+				num_not_run += value.size();
+				suite_missing = true;
+				continue;
+			}
+
+			for (std::size_t i = 0; i < value.size(); ++i)
+			{
+				auto remaining = static_cast<int>(value.size() - i);
+				if (token.cancelled())
+				{
+					num_not_run += value.size() - i;
+					release_fixtures(key, remaining);
+					tear_down(key);
+					break;
+				}
+
+				if (!key.empty() && !run_suite(output, true, key, num_passed, num_failed))
+				{
+					output << "Test suite setup failed."
+						   << " Skipping tests in suite."
+						   << std::endl;
+
+					num_not_run += value.size() - i;
+					release_fixtures(key, remaining);
+					tear_down(key);
+					break;
+				}
+
+				int failures_before = num_failed + num_missed_failed;
+				auto start = std::chrono::steady_clock::now();
+				run_test(output, value[i], num_passed, num_failed, num_missed_failed);
+				if (!history_file.empty())
+				{
+					auto elapsed = std::chrono::steady_clock::now() - start;
+					record_history(history[history_key(value[i])],
+							num_failed + num_missed_failed != failures_before,
+							std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+				}
+				if (value[i]->limit_exceeded() != ResourceLimit::none
+					&& value[i]->expected_reason() != value[i]->reason())
+				{
+					++num_over_limit;
+				}
+				check_fail_fast();
+
+				release_fixtures(key, 1);
+				tear_down(key);
+			}
+		}
+
+		if (!history_file.empty())
+		{
+			// Tests that are no longer registered are dropped. Tests
+			// that did not run keep their previous entries.
+			std::set<HistoryKey> registered;
+			for (auto const& [key, value]: get_tests())
+			{
+				for (auto* test: value)
+				{
+					registered.insert(history_key(test));
+				}
+			}
+			std::erase_if(history, [&registered](auto const& entry)
+			{
+				return !registered.contains(entry.first);
+			});
+			write_history(history_file, history);
+		}
+
+		report_check_totals(output);
+
+		RunSummary summary{ num_passed, num_failed, num_missed_failed, num_over_limit, num_not_run };
+		report_summary(output, summary);
+		if (!get_run_options().summary_file.empty())
+		{
+			write_summary(get_run_options().summary_file, summary);
+		}
+
+		return num_failed;
+	}
+
+	void report_summary(std::ostream& output, RunSummary const& summary)
+	{
+		output << "-----------------------------------\n";
+
+		output << "Tests passed: " << summary.passed
+			   << "\nTests failed: " << summary.failed;
+
+		if (summary.missed_failed != 0)
+		{
+			output << "\nTests failures missed: " << summary.missed_failed;
+		}
+
+		if (summary.over_limit != 0)
+		{
+			output << "\nTests over resource limits: " << summary.over_limit;
+		}
+
+		if (summary.not_run != 0)
+		{
+			output << "\nTests not run: " << summary.not_run;
+		}
+
+		output << std::endl;
+	}
+
+	bool write_summary(std::string const& path, RunSummary const& summary)
+	{
+		std::ofstream file(path, std::ios::trunc);
+		file << "passed " << summary.passed
+			 << "\nfailed " << summary.failed
+			 << "\nmissed_failed " << summary.missed_failed
+			 << "\nover_limit " << summary.over_limit
+			 << "\nnot_run " << summary.not_run
+			 << '\n';
+		return static_cast<bool>(file);
+	}
+
+	bool read_summary(std::string const& path, RunSummary& summary)
+	{
+		std::ifstream file(path);
+		std::string name;
+		long long value = 0;
+		int fields = 0;
+		while (file >> name >> value)
+		{
+			if (name == "passed")
+			{
+				summary.passed = static_cast<int>(value);
+			}
+			else if (name == "failed")
+			{
+				summary.failed = static_cast<int>(value);
+			}
+			else if (name == "missed_failed")
+			{
+				summary.missed_failed = static_cast<int>(value);
+			}
+			else if (name == "over_limit")
+			{
+				summary.over_limit = static_cast<int>(value);
+			}
+			else if (name == "not_run")
+			{
+				summary.not_run = static_cast<std::size_t>(value);
+			}
+			else
+			{
+				continue;
+			}
+			++fields;
+		}
+		// A file cut short by a crash is not a summary.
+		return fields == 5;
+	}
+
+	void list_tests(std::ostream& output, ListMode mode)
+	{
+		auto const& suites = get_test_suites();
+		bool json = mode == ListMode::json;
+		if (json)
+		{
+			output << "{\"suites\":[";
+		}
+
+		// Suites that only have fixtures so far are listed too.
+		std::set<std::string> names;
+		for (auto const& [key, value]: get_tests())
+		{
+			names.insert(key);
+		}
+		for (auto const& [key, value]: suites)
+		{
+			names.insert(key);
+		}
+
+		static std::vector<Test*> const no_tests;
+		bool first_suite = true;
+		for (auto const& key: names)
+		{
+			auto tests = get_tests().find(key);
+			auto const& value = tests == get_tests().end() ? no_tests : tests->second;
+			auto fixtures = suites.find(key);
+			if (json)
+			{
+				output << (first_suite ? "" : ",") << "\n{\"name\":";
+				write_json_string(output, key);
+				output << ",\"fixtures\":[";
+				if (fixtures != suites.end())
+				{
+					bool first = true;
+					for (auto const* suite: fixtures->second)
+					{
+						output << (first ? "" : ",") << "{\"name\":";
+						write_json_string(output, suite->name());
+						output << ',';
+						write_json_location(output, suite);
+						output << '}';
+						first = false;
+					}
+				}
+				output << "],\"tests\":[";
+				bool first = true;
+				for (auto const* test: value)
+				{
+					output << (first ? "" : ",") << "\n{\"name\":";
+					write_json_string(output, test->name());
+					output << ",\"exception\":";
+					write_json_string(output, test->exception_name());
+					output << ',';
+					write_json_location(output, test);
+					output << '}';
+					first = false;
+				}
+				output << "]}";
+				first_suite = false;
+				continue;
+			}
+
+			output << "Suite: " << (key.empty() ? "Single Tests" : key) << '\n';
+			if (fixtures != suites.end())
+			{
+				for (auto const* suite: fixtures->second)
+				{
+					output << "  Fixture: " << suite->name()
+						   << " (" << suite->location().file_name()
+						   << ':' << suite->location().line() << ")\n";
+				}
+			}
+			for (auto const* test: value)
+			{
+				output << "  " << test->name();
+				if (!test->exception_name().empty())
+				{
+					output << " [throws " << test->exception_name() << ']';
+				}
+				output << " (" << test->location().file_name()
+					   << ':' << test->location().line() << ")\n";
+			}
+		}
+
+		if (json)
+		{
+			output << "\n]}\n";
+		}
+		output.flush();
+	}
+
+#ifdef MERETDD_HAS_POSIX
+	namespace
+	{
+		// Every frame is its length followed by a record whose first
+		// number is one of these.
+		enum class Message : std::uint64_t
+		{
+			// Worker: protocol version, local pid or zero, test count
+			// and fingerprint of the test names.
+			hello = 1,
+			// Coordinator: id of the next test to run.
+			run,
+			// Worker: test id, whether it was skipped because its suite
+			// setup failed, then the result record of a test that ran.
+			result,
+			// Worker: suite name, setup or teardown, passed, counts and
+			// the report run_suite wrote.
+			suite,
+			// Coordinator: nothing left, tear the suites down and leave.
+			done,
+			// Coordinator: suite name. No test of the suite is left, so
+			// the worker can tear down the fixtures only it needed.
+			release,
+			// Coordinator: the run was cancelled, so the running test
+			// should stop early.
+			cancel,
+		};
+
+		constexpr std::uint64_t protocol_version = 2;
+
+		constexpr std::uint64_t max_frame_size = 64 << 20;
+
+		// Runs that bring a worker down are retried on another worker
+		// up to this many times in total before the test is failed.
+		constexpr int max_attempts = 3;
+
+		// A connection that has not said hello by then is closed, so a
+		// stray client cannot hold the run open.
+		constexpr auto hello_timeout = std::chrono::seconds(10);
+
+		// Both sides number the tests in registration map order, which
+		// is the same in every process of the same binary.
+		std::vector<Test*> numbered_tests()
+		{
+			std::vector<Test*> tests;
+			for (auto const& [key, value]: get_tests())
+			{
+				tests.insert(tests.end(), value.begin(), value.end());
+			}
+			return tests;
+		}
+
+		std::uint64_t test_fingerprint(std::vector<Test*> const& tests)
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+			auto add = [&hash](std::string_view text)
+			{
+				for (char c: text)
+				{
+					hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+				}
+				hash = (hash ^ 0xff) * 1099511628211ull;
+			};
+			for (auto const* test: tests)
+			{
+				add(test->suite_name());
+				add(test->name());
+			}
+			return hash;
+		}
+
+		void send_frame(int fd, RecordWriter const& record)
+		{
+			RecordWriter frame;
+			frame.put_number(record.data().size());
+			write_all(fd, frame.data() + record.data());
+		}
+
+		// Moves one whole frame out of the buffer when it holds one.
+		bool take_frame(std::string& buffer, std::string& frame)
+		{
+			RecordReader header(buffer);
+			std::uint64_t size = header.get_number();
+			if (!header.ok() || buffer.size() - 8 < size)
+			{
+				return false;
+			}
+			frame.assign(buffer, 8, size);
+			buffer.erase(0, 8 + size);
+			return true;
+		}
+
+		bool frame_too_large(std::string const& buffer)
+		{
+			RecordReader header(buffer);
+			std::uint64_t size = header.get_number();
+			return header.ok() && size > max_frame_size;
+		}
+
+		// Removes the cancel frames from the buffer and keeps the other
+		// frames in order. Returns whether there was one.
+		bool take_cancel_frames(std::string& buffer)
+		{
+			bool cancelled = false;
+			std::string kept;
+			std::string frame;
+			while (take_frame(buffer, frame))
+			{
+				RecordReader record(frame);
+				if (static_cast<Message>(record.get_number()) == Message::cancel)
+				{
+					cancelled = true;
+					continue;
+				}
+				RecordWriter header;
+				header.put_number(frame.size());
+				kept += header.data() + frame;
+			}
+			buffer.insert(0, kept);
+			return cancelled;
+		}
+
+		// Reads the connection while a worker runs a test, so a cancel
+		// from the coordinator reaches the test through the
+		// cancellation token. Everything else is left for the worker.
+		class CancelWatcher
+		{
+		public:
+			CancelWatcher(int fd, std::string& buffer) :
+					m_fd(fd), m_buffer(buffer)
+			{
+				if (pipe(m_wake) != 0)
+				{
+					m_wake[0] = -1;
+					m_wake[1] = -1;
+					return;
+				}
+				m_thread = std::thread([this]()
+				{
+					watch();
+				});
+			}
+
+			CancelWatcher(CancelWatcher const&) = delete;
+
+			CancelWatcher& operator=(CancelWatcher const&) = delete;
+
+			~CancelWatcher()
+			{
+				if (m_thread.joinable())
+				{
+					char wake = 0;
+					while (write(m_wake[1], &wake, 1) == -1 && errno == EINTR)
+					{
+					}
+					m_thread.join();
+				}
+				if (m_wake[0] != -1)
+				{
+					close(m_wake[0]);
+					close(m_wake[1]);
+				}
+			}
+
+		private:
+			void watch()
+			{
+				char chunk[4096];
+				while (true)
+				{
+					pollfd fds[] = { { m_fd, POLLIN, 0 }, { m_wake[0], POLLIN, 0 } };
+					if (poll(fds, 2, -1) < 0)
+					{
+						if (errno == EINTR)
+						{
+							continue;
+						}
+						return;
+					}
+					if (fds[1].revents != 0)
+					{
+						return;
+					}
+
+					ssize_t count = read(m_fd, chunk, sizeof(chunk));
+					if (count < 0 && errno == EINTR)
+					{
+						continue;
+					}
+					if (count <= 0)
+					{
+						// The worker sees the closed connection on its
+						// next read.
+						return;
+					}
+					m_buffer.append(chunk, static_cast<std::size_t>(count));
+					if (take_cancel_frames(m_buffer))
+					{
+						get_cancellation_token().cancel();
+					}
+				}
+			}
+
+			int m_fd;
+			std::string& m_buffer;
+			int m_wake[2]{ -1, -1 };
+			std::thread m_thread;
+		};
+
+		bool read_frame(int fd, std::string& buffer, std::string& frame)
+		{
+			char chunk[4096];
+			while (!take_frame(buffer, frame))
+			{
+				if (frame_too_large(buffer))
+				{
+					return false;
+				}
+				ssize_t count = read(fd, chunk, sizeof(chunk));
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (count <= 0)
+				{
+					return false;
+				}
+				buffer.append(chunk, static_cast<std::size_t>(count));
+			}
+			return true;
+		}
+
+		// "unix:<path>" or "tcp:<host>:<port>". An empty or "*" host
+		// listens on every interface.
+		struct SocketAddress
+		{
+			bool tcp{ false };
+			std::string path;
+			std::string host;
+			std::string port;
+		};
+
+		std::optional<SocketAddress> parse_address(std::string_view address)
+		{
+			SocketAddress parsed;
+			if (address.starts_with("unix:"))
+			{
+				parsed.path = address.substr(5);
+				if (parsed.path.empty() || parsed.path.size() >= sizeof(sockaddr_un::sun_path))
+				{
+					return std::nullopt;
+				}
+				return parsed;
+			}
+			if (address.starts_with("tcp:"))
+			{
+				address.remove_prefix(4);
+				auto colon = address.rfind(':');
+				if (colon == std::string_view::npos)
+				{
+					return std::nullopt;
+				}
+				parsed.tcp = true;
+				parsed.host = address.substr(0, colon);
+				parsed.port = address.substr(colon + 1);
+				if (parsed.host == "*")
+				{
+					parsed.host.clear();
+				}
+				return parsed;
+			}
+			return std::nullopt;
+		}
+
+		// Returns the listening socket and, in connect_address, where
+		// local workers reach it. A TCP port of 0 picks a free port.
+		int listen_on(SocketAddress const& address, std::string& connect_address)
+		{
+			if (!address.tcp)
+			{
+				int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+				sockaddr_un local{};
+				local.sun_family = AF_UNIX;
+				std::strncpy(local.sun_path, address.path.c_str(), sizeof(local.sun_path) - 1);
+				unlink(address.path.c_str());
+				if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 || listen(fd, 64) != 0)
+				{
+					if (fd >= 0)
+					{
+						close(fd);
+					}
+					return -1;
+				}
+				connect_address = "unix:" + address.path;
+				return fd;
+			}
+
+			addrinfo hints{};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_flags = AI_PASSIVE;
+			addrinfo* found = nullptr;
+			if (getaddrinfo(address.host.empty() ? nullptr : address.host.c_str(), address.port.c_str(),
+					&hints, &found) != 0)
+			{
+				return -1;
+			}
+
+			int fd = -1;
+			for (addrinfo* candidate = found; candidate != nullptr && fd < 0; candidate = candidate->ai_next)
+			{
+				fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+				if (fd < 0)
+				{
+					continue;
+				}
+				int reuse = 1;
+				setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+				if (bind(fd, candidate->ai_addr, candidate->ai_addrlen) != 0 || listen(fd, 64) != 0)
+				{
+					close(fd);
+					fd = -1;
+				}
+			}
+			freeaddrinfo(found);
+			if (fd < 0)
+			{
+				return -1;
+			}
+
+			sockaddr_storage bound{};
+			socklen_t length = sizeof(bound);
+			char port[NI_MAXSERV] = "";
+			getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &length);
+			getnameinfo(reinterpret_cast<sockaddr*>(&bound), length, nullptr, 0, port, sizeof(port), NI_NUMERICSERV);
+			std::string host = address.host.empty() ? "127.0.0.1" : address.host;
+			connect_address = "tcp:" + host + ":" + port;
+			return fd;
+		}
+
+		int connect_to(SocketAddress const& address)
+		{
+			if (!address.tcp)
+			{
+				int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+				sockaddr_un remote{};
+				remote.sun_family = AF_UNIX;
+				std::strncpy(remote.sun_path, address.path.c_str(), sizeof(remote.sun_path) - 1);
+				if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) == 0)
+				{
+					return fd;
+				}
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+				return -1;
+			}
+
+			addrinfo hints{};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			addrinfo* found = nullptr;
+			if (getaddrinfo(address.host.c_str(), address.port.c_str(), &hints, &found) != 0)
+			{
+				return -1;
+			}
+
+			int fd = -1;
+			for (addrinfo* candidate = found; candidate != nullptr && fd < 0; candidate = candidate->ai_next)
+			{
+				fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+				if (fd >= 0 && connect(fd, candidate->ai_addr, candidate->ai_addrlen) != 0)
+				{
+					close(fd);
+					fd = -1;
+				}
+			}
+			freeaddrinfo(found);
+			return fd;
+		}
+
+		bool send_suite(int fd, std::string const& name, bool setup)
+		{
+			std::ostringstream report;
+			int num_passed = 0;
+			int num_failed = 0;
+			bool passed = run_suite(report, setup, name, num_passed, num_failed);
+
+			RecordWriter record;
+			record.put_number(static_cast<std::uint64_t>(Message::suite));
+			record.put_string(name);
+			record.put_number(setup ? 1 : 0);
+			record.put_number(passed ? 1 : 0);
+			record.put_number(static_cast<std::uint64_t>(num_passed));
+			record.put_number(static_cast<std::uint64_t>(num_failed));
+			record.put_string(report.str());
+			send_frame(fd, record);
+			return passed;
+		}
+
+		// Runs the tests the coordinator hands out until it has none
+		// left. A suite is set up when the first of its tests arrives
+		// and torn down, in reverse order, at the end.
+		int run_worker(std::ostream& output, std::string const& address, bool local)
+		{
+			std::signal(SIGPIPE, SIG_IGN);
+
+			auto parsed = parse_address(address);
+			int fd = -1;
+			// A worker may be started before its coordinator listens.
+			for (int attempt = 0; parsed && fd < 0 && attempt < 50; ++attempt)
+			{
+				fd = connect_to(*parsed);
+				if (fd < 0)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				}
+			}
+			if (fd < 0)
+			{
+				output << "Cannot reach the coordinator at " << address << '.' << std::endl;
+				return 1;
+			}
+
+			auto tests = numbered_tests();
+			RecordWriter hello;
+			hello.put_number(static_cast<std::uint64_t>(Message::hello));
+			hello.put_number(protocol_version);
+			hello.put_number(local ? static_cast<std::uint64_t>(getpid()) : 0);
+			hello.put_number(tests.size());
+			hello.put_number(test_fingerprint(tests));
+			send_frame(fd, hello);
+
+			std::map<std::string, bool> suites;
+			std::vector<std::string> setup_order;
+			std::string buffer;
+			std::string frame;
+			while (read_frame(fd, buffer, frame))
+			{
+				RecordReader record(frame);
+				auto type = static_cast<Message>(record.get_number());
+				if (type == Message::done)
+				{
+					for (auto name = setup_order.rbegin(); name != setup_order.rend(); ++name)
+					{
+						release_fixtures(*name, 1);
+						send_suite(fd, *name, false);
+					}
+					break;
+				}
+
+				if (type == Message::cancel)
+				{
+					// The test it was meant for already finished.
+					continue;
+				}
+
+				if (type == Message::release)
+				{
+					std::string name(record.get_string());
+					auto found = std::find(setup_order.begin(), setup_order.end(), name);
+					if (found != setup_order.end())
+					{
+						setup_order.erase(found);
+						suites.erase(name);
+						release_fixtures(name, 1);
+						send_suite(fd, name, false);
+					}
+					continue;
+				}
+
+				std::uint64_t id = record.get_number();
+				if (type != Message::run || !record.ok() || id >= tests.size())
+				{
+					break;
+				}
+
+				Test* test = tests[id];
+				std::string suite(test->suite_name());
+				bool ready = true;
+				if (!suite.empty())
+				{
+					auto found = suites.find(suite);
+					if (found == suites.end())
+					{
+						// Each suite set up here holds one reference on
+						// its fixtures, so a fixture shared by suites
+						// lasts until the last of them is released.
+						retain_fixtures(suite, 1);
+						ready = send_suite(fd, suite, true);
+						suites.emplace(suite, ready);
+						if (ready)
+						{
+							setup_order.push_back(suite);
+						}
+						else
+						{
+							release_fixtures(suite, 1);
+							send_suite(fd, suite, false);
+						}
+					}
+					else
+					{
+						ready = found->second;
+					}
+				}
+
+				RecordWriter reply;
+				reply.put_number(static_cast<std::uint64_t>(Message::result));
+				reply.put_number(id);
+				reply.put_number(ready ? 0 : 1);
+				if (ready)
+				{
+					get_cancellation_token().reset();
+					{
+						CancelWatcher watcher(fd, buffer);
+						execute(output, test);
+					}
+					write_result(reply, test);
+				}
+				send_frame(fd, reply);
+			}
+
+			close(fd);
+			return 0;
+		}
+
+		class Coordinator
+		{
+		public:
+			explicit Coordinator(std::ostream& output) :
+					m_output(output),
+					m_tests(numbered_tests()),
+					m_fingerprint(test_fingerprint(m_tests)),
+					m_attempts(m_tests.size(), 0)
+			{
+				for (std::size_t id = 0; id < m_tests.size(); ++id)
+				{
+					if (is_selected(m_tests[id]))
+					{
+						m_pending[std::string(m_tests[id]->suite_name())].push_back(id);
+					}
+				}
+			}
+
+			int run()
+			{
+				auto const& options = get_run_options();
+				std::string listen_address = options.listen_address;
+				if (listen_address.empty())
+				{
+					auto path = std::filesystem::temp_directory_path()
+							/ ("meretdd-" + std::to_string(getpid()) + ".sock");
+					listen_address = "unix:" + path.string();
+				}
+
+				auto parsed = parse_address(listen_address);
+				if (parsed)
+				{
+					m_listener = listen_on(*parsed, m_connect_address);
+				}
+				if (m_listener < 0)
+				{
+					m_output << "Cannot listen on " << listen_address << '.' << std::endl;
+					return 1;
+				}
+
+				std::signal(SIGPIPE, SIG_IGN);
+				auto& token = get_cancellation_token();
+				token.reset();
+				InterruptCancellation interrupt_cancellation;
+				CheckTotalsScope check_totals;
+				TestStateScope test_state;
+
+				m_output << "Running " << m_tests.size() << " tests on "
+						 << options.workers << (options.workers == 1 ? " worker" : " workers");
+				if (!options.listen_address.empty())
+				{
+					m_output << ", listening on " << m_connect_address;
+				}
+				m_output << std::endl;
+
+				for (int i = 0; i < options.workers; ++i)
+				{
+					spawn_local_worker();
+				}
+
+				while (!finished())
+				{
+					assign_idle_workers();
+					release_finished_suites();
+					wait_for_events();
+					drop_silent_connections();
+					cancel_running_tests();
+					reap_local_workers();
+
+					// Without a listen address no other worker can join.
+					if (!any_greeted() && m_unconnected.empty() && options.listen_address.empty()
+						&& work_left())
+					{
+						m_output << "No workers are left to run the remaining tests." << std::endl;
+						token.cancel();
+					}
+				}
+
+				for (auto const& connection: m_connections)
+				{
+					close(connection.fd);
+				}
+				close(m_listener);
+				if (!parsed->tcp)
+				{
+					unlink(parsed->path.c_str());
+				}
+
+				for (auto const& [suite, ids]: m_pending)
+				{
+					m_summary.not_run += ids.size();
+				}
+
+				report_check_totals(m_output);
+
+				if (m_restarts != 0)
+				{
+					m_output << "Workers restarted: " << m_restarts << std::endl;
+				}
+				if (m_retries != 0)
+				{
+					m_output << "Tests retried: " << m_retries << std::endl;
+				}
+
+				report_summary(m_output, m_summary);
+				if (!options.summary_file.empty())
+				{
+					write_summary(options.summary_file, m_summary);
+				}
+				return m_summary.failed;
+			}
+
+		private:
+			struct Connection
+			{
+				explicit Connection(int fd) :
+						fd(fd), accepted(std::chrono::steady_clock::now())
+				{
+				}
+
+				int fd{ -1 };
+				pid_t pid{ 0 };
+				bool greeted{ false };
+				bool done_sent{ false };
+				bool cancel_sent{ false };
+				std::string buffer;
+				std::optional<std::size_t> running;
+				std::string suite;
+				// Suites the worker has set up and not yet released.
+				std::set<std::string> suites;
+				std::chrono::steady_clock::time_point accepted;
+			};
+
+			bool work_left() const
+			{
+				if (get_cancellation_token().cancelled())
+				{
+					return false;
+				}
+				return std::any_of(m_pending.begin(), m_pending.end(), [](auto const& entry)
+				{
+					return !entry.second.empty();
+				});
+			}
+
+			bool in_flight() const
+			{
+				return std::any_of(m_connections.begin(), m_connections.end(), [](Connection const& connection)
+				{
+					return connection.running.has_value();
+				});
+			}
+
+			bool any_greeted() const
+			{
+				return std::any_of(m_connections.begin(), m_connections.end(), [](Connection const& connection)
+				{
+					return connection.greeted;
+				});
+			}
+
+			// Connections that never said hello do not hold the run
+			// open. Local workers count until they connect.
+			bool finished() const
+			{
+				if (work_left() || in_flight())
+				{
+					return false;
+				}
+				// Wait for workers to send their suite teardowns.
+				return !any_greeted() && m_unconnected.empty();
+			}
+
+			void spawn_local_worker()
+			{
+				m_output.flush();
+				std::fflush(nullptr);
+
+				pid_t pid = fork();
+				if (pid == 0)
+				{
+					close(m_listener);
+					for (auto const& connection: m_connections)
+					{
+						close(connection.fd);
+					}
+					int code = run_worker(m_output, m_connect_address, true);
+					m_output.flush();
+					std::fflush(nullptr);
+					_exit(code);
+				}
+				if (pid > 0)
+				{
+					m_unconnected.insert(pid);
+				}
+			}
+
+			void assign_idle_workers()
+			{
+				bool more = work_left();
+				for (auto& connection: m_connections)
+				{
+					if (!connection.greeted || connection.running || connection.done_sent)
+					{
+						continue;
+					}
+
+					if (!more)
+					{
+						if (!in_flight())
+						{
+							RecordWriter done;
+							done.put_number(static_cast<std::uint64_t>(Message::done));
+							send_frame(connection.fd, done);
+							connection.done_sent = true;
+						}
+						continue;
+					}
+
+					// Stay in the suite the worker has set up while it
+					// has tests left, so fixtures are set up once per
+					// worker rather than once per test.
+					auto suite = m_pending.find(connection.suite);
+					if (suite == m_pending.end() || suite->second.empty())
+					{
+						suite = std::find_if(m_pending.begin(), m_pending.end(), [](auto const& entry)
+						{
+							return !entry.second.empty();
+						});
+					}
+
+					std::size_t id = suite->second.front();
+					suite->second.pop_front();
+					connection.running = id;
+					connection.suite = suite->first;
+					if (!suite->first.empty())
+					{
+						connection.suites.insert(suite->first);
+					}
+
+					RecordWriter run;
+					run.put_number(static_cast<std::uint64_t>(Message::run));
+					run.put_number(id);
+					send_frame(connection.fd, run);
+					more = work_left();
+				}
+			}
+
+			// Once a suite has no tests left to hand out, each worker tears
+			// it down as soon as it is not running one of its tests.
+			void release_finished_suites()
+			{
+				for (auto& connection: m_connections)
+				{
+					if (connection.done_sent)
+					{
+						continue;
+					}
+					std::erase_if(connection.suites, [&](std::string const& suite)
+					{
+						bool busy = connection.running && m_tests[*connection.running]->suite_name() == suite;
+						if (busy || !m_pending[suite].empty())
+						{
+							return false;
+						}
+
+						RecordWriter release;
+						release.put_number(static_cast<std::uint64_t>(Message::release));
+						release.put_string(suite);
+						send_frame(connection.fd, release);
+						return true;
+					});
+				}
+			}
+
+			void wait_for_events()
+			{
+				std::vector<pollfd> fds;
+				fds.push_back({ m_listener, POLLIN, 0 });
+				for (auto const& connection: m_connections)
+				{
+					fds.push_back({ connection.fd, POLLIN, 0 });
+				}
+
+				// Woken regularly to reap workers that never connected
+				// and to notice an interrupt.
+				if (poll(fds.data(), fds.size(), 200) <= 0)
+				{
+					return;
+				}
+
+				if (fds[0].revents & POLLIN)
+				{
+					int fd = accept(m_listener, nullptr, nullptr);
+					if (fd >= 0)
+					{
+						m_connections.emplace_back(fd);
+					}
+				}
+
+				// Read everything first; closing a connection changes
+				// the list.
+				std::vector<int> closed;
+				for (std::size_t i = 1; i < fds.size(); ++i)
+				{
+					if (fds[i].revents == 0)
+					{
+						continue;
+					}
+					auto connection = std::find_if(m_connections.begin(), m_connections.end(),
+							[fd = fds[i].fd](Connection const& candidate)
+							{
+								return candidate.fd == fd;
+							});
+					if (!receive(*connection))
+					{
+						closed.push_back(connection->fd);
+					}
+				}
+				for (int fd: closed)
+				{
+					drop(fd);
+				}
+			}
+
+			// Tests already running on workers are asked to stop once
+			// the run is cancelled by --fail-fast or an interrupt.
+			void cancel_running_tests()
+			{
+				if (!get_cancellation_token().cancelled())
+				{
+					return;
+				}
+				for (auto& connection: m_connections)
+				{
+					if (connection.running && !connection.cancel_sent)
+					{
+						RecordWriter cancel;
+						cancel.put_number(static_cast<std::uint64_t>(Message::cancel));
+						send_frame(connection.fd, cancel);
+						connection.cancel_sent = true;
+					}
+				}
+			}
+
+			void drop_silent_connections()
+			{
+				auto now = std::chrono::steady_clock::now();
+				std::vector<int> silent;
+				for (auto const& connection: m_connections)
+				{
+					if (!connection.greeted && now - connection.accepted > hello_timeout)
+					{
+						silent.push_back(connection.fd);
+					}
+				}
+				for (int fd: silent)
+				{
+					m_output << "A connection that sent no hello was closed." << std::endl;
+					drop(fd);
+				}
+			}
+
+			bool receive(Connection& connection)
+			{
+				char chunk[4096];
+				ssize_t count = read(connection.fd, chunk, sizeof(chunk));
+				if (count < 0 && errno == EINTR)
+				{
+					return true;
+				}
+				if (count <= 0)
+				{
+					return false;
+				}
+				connection.buffer.append(chunk, static_cast<std::size_t>(count));
+
+				std::string frame;
+				while (take_frame(connection.buffer, frame))
+				{
+					if (!handle(connection, frame))
+					{
+						return false;
+					}
+				}
+				return !frame_too_large(connection.buffer);
+			}
+
+			bool handle(Connection& connection, std::string const& frame)
+			{
+				RecordReader record(frame);
+				auto type = static_cast<Message>(record.get_number());
+				if (type == Message::hello)
+				{
+					std::uint64_t version = record.get_number();
+					auto pid = static_cast<pid_t>(record.get_number());
+					std::uint64_t count = record.get_number();
+					std::uint64_t fingerprint = record.get_number();
+					if (!record.ok() || version != protocol_version
+						|| count != m_tests.size() || fingerprint != m_fingerprint)
+					{
+						m_output << "A worker with a different test binary was turned away." << std::endl;
+						return false;
+					}
+					if (m_unconnected.erase(pid) != 0)
+					{
+						connection.pid = pid;
+					}
+					connection.greeted = true;
+					return true;
+				}
+
+				if (!connection.greeted)
+				{
+					return false;
+				}
+
+				if (type == Message::suite)
+				{
+					std::string name(record.get_string());
+					bool setup = record.get_number() != 0;
+					bool passed = record.get_number() != 0;
+					auto num_passed = static_cast<int>(record.get_number());
+					auto num_failed = static_cast<int>(record.get_number());
+					std::string_view report = record.get_string();
+					if (!record.ok())
+					{
+						return false;
+					}
+
+					if (report.empty())
+					{
+						return true;
+					}
+					print_suite_header(name);
+					m_output << report;
+					m_summary.passed += num_passed;
+					m_summary.failed += num_failed;
+					if (!passed)
+					{
+						if (setup)
+						{
+							m_output << "Test suite setup failed."
+									 << " Skipping tests in suite."
+									 << std::endl;
+							m_summary.not_run += m_pending[name].size();
+							m_pending[name].clear();
+						}
+						else
+						{
+							m_output << "Test suite teardown failed." << std::endl;
+						}
+					}
+					check_fail_fast();
+					return true;
+				}
+
+				std::uint64_t id = record.get_number();
+				bool skipped = record.get_number() != 0;
+				if (type != Message::result || !record.ok() || !connection.running || *connection.running != id)
+				{
+					return false;
+				}
+
+				Test* test = m_tests[id];
+				if (skipped)
+				{
+					++m_summary.not_run;
+				}
+				else
+				{
+					if (!read_result(record, test))
+					{
+						return false;
+					}
+					report(test);
+				}
+				connection.running.reset();
+				connection.cancel_sent = false;
+				return true;
+			}
+
+			void report(Test* test)
+			{
+				print_suite_header(std::string(test->suite_name()));
+				m_output << "------- Test: "
+						 << test->name()
+						 << std::endl;
+				report_test_result(m_output, test, m_summary.passed, m_summary.failed, m_summary.missed_failed);
+				if (test->limit_exceeded() != ResourceLimit::none && test->expected_reason() != test->reason())
+				{
+					++m_summary.over_limit;
+				}
+				check_fail_fast();
+			}
+
+			// Results arrive in whatever order workers finish, so the
+			// suite heading is repeated whenever it changes.
+			void print_suite_header(std::string const& suite)
+			{
+				if (m_last_suite && *m_last_suite == suite)
+				{
+					return;
+				}
+				m_last_suite = suite;
+				m_output << "---------------- Suite: "
+						 << (suite.empty() ? "Single Tests" : suite)
+						 << std::endl;
+			}
+
+			void check_fail_fast()
+			{
+				int fail_fast = get_run_options().fail_fast;
+				auto& token = get_cancellation_token();
+				if (fail_fast > 0 && m_summary.failed >= fail_fast && !token.cancelled())
+				{
+					m_output << "Stopping after " << m_summary.failed
+							 << (m_summary.failed == 1 ? " failure." : " failures.")
+							 << std::endl;
+					token.cancel();
+				}
+			}
+
+			// The test a worker was running when it went away is handed
+			// to another worker, and a local worker is replaced while
+			// there is still work for it.
+			void drop(int fd)
+			{
+				auto connection = std::find_if(m_connections.begin(), m_connections.end(),
+						[fd](Connection const& candidate)
+						{
+							return candidate.fd == fd;
+						});
+				close(fd);
+
+				bool local = connection->pid != 0;
+				if (connection->running)
+				{
+					retry_or_fail(*connection->running);
+				}
+				bool stopped_early = !connection->done_sent;
+				m_connections.erase(connection);
+
+				if (local && stopped_early)
+				{
+					restart_local_worker();
+				}
+			}
+
+			void retry_or_fail(std::size_t id)
+			{
+				Test* test = m_tests[id];
+				if (++m_attempts[id] < max_attempts)
+				{
+					++m_retries;
+					m_pending[std::string(test->suite_name())].push_front(id);
+					return;
+				}
+
+				test->set_failed("Worker process stopped while running the test "
+								 + std::to_string(max_attempts) + " times.");
+				report(test);
+			}
+
+			void restart_local_worker()
+			{
+				// Every restart follows a test attempt or a worker that
+				// never connected, so this only stops a crash loop.
+				auto max_restarts = static_cast<int>(m_tests.size() + 1) * max_attempts;
+				if ((!work_left() && !in_flight()) || m_restarts >= max_restarts)
+				{
+					return;
+				}
+				++m_restarts;
+				spawn_local_worker();
+			}
+
+			// Workers that die before they connect never show up as a
+			// closed connection.
+			void reap_local_workers()
+			{
+				int status = 0;
+				pid_t pid;
+				while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+				{
+					if (m_unconnected.erase(pid) != 0)
+					{
+						restart_local_worker();
+					}
+				}
+			}
+
+			std::ostream& m_output;
+			std::vector<Test*> m_tests;
+			std::uint64_t m_fingerprint;
+			std::vector<int> m_attempts;
+			std::map<std::string, std::deque<std::size_t>> m_pending;
+			std::vector<Connection> m_connections;
+			std::set<pid_t> m_unconnected;
+			int m_listener{ -1 };
+			std::string m_connect_address;
+			std::optional<std::string> m_last_suite;
+			RunSummary m_summary;
+			int m_restarts{ 0 };
+			int m_retries{ 0 };
+		};
+	}
+#endif
+
+	int run_tests(std::ostream& output, int argc, char* argv[])
+	{
+		parse_options(argc, argv);
+
+		if (get_run_options().list != ListMode::none)
+		{
+			list_tests(output, get_run_options().list);
+			return 0;
+		}
+
+		if (get_run_options().benchmark)
+		{
+			return run_benchmarks(output);
+		}
+
+#ifdef MERETDD_HAS_POSIX
+		if (!get_run_options().worker_address.empty())
+		{
+			return run_worker(output, get_run_options().worker_address, false);
+		}
+
+		if (get_run_options().workers > 0 || !get_run_options().listen_address.empty())
+		{
+			return Coordinator(output).run();
+		}
+#endif
+
+		return run_tests(output);
+	}
+}
+
+#ifdef MERETDD_FUZZ
+// libFuzzer entry points. The binary is linked without main(); libFuzzer
+// passes flags starting with "--" through untouched, so the target is
+// chosen with --fuzz-target=<test name> when there is more than one.
+namespace
+{
+	MereTDD::FuzzTest* fuzz_target = nullptr;
+}
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+	std::string_view selected;
+	for (int i = 1; i < *argc; ++i)
+	{
+		std::string_view arg((*argv)[i]);
+		if (arg.starts_with("--fuzz-target="))
+		{
+			selected = arg.substr(arg.find('=') + 1);
+		}
+	}
+
+	std::vector<MereTDD::FuzzTest*> targets;
+	for (auto const& [key, value]: MereTDD::get_tests())
+	{
+		for (auto* test: value)
+		{
+			if (auto* target = dynamic_cast<MereTDD::FuzzTest*>(test))
+			{
+				targets.push_back(target);
+			}
+		}
+	}
+
+	for (auto* target: targets)
+	{
+		if (target->name() == selected || (selected.empty() && targets.size() == 1))
+		{
+			fuzz_target = target;
+			return 0;
+		}
+	}
+
+	std::fprintf(stderr, "Select a fuzz target with --fuzz-target=<name>. Available targets:\n");
+	for (auto* target: targets)
+	{
+		std::fprintf(stderr, "  %.*s\n", static_cast<int>(target->name().size()), target->name().data());
+	}
+	std::exit(1);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+	// Failures become aborts, which libFuzzer records as crashes and
+	// saves the input for.
+	try
+	{
+		fuzz_target->run_input(data, size);
+	}
+	catch (const MereTDD::ConfirmException& ex)
+	{
+		std::fprintf(stderr, "Failed confirm on line %d\n%.*s\n", ex.line(),
+				static_cast<int>(ex.reason().size()), ex.reason().data());
+		std::abort();
+	}
+	catch (...)
+	{
+		std::fprintf(stderr, "Unexpected exception thrown.\n");
+		std::abort();
+	}
+	return 0;
+}
+#endif
@@ -9,16 +9,28 @@
     the licensing of this work. If you have any questions or concerns,
     please feel free to contact me at the email address provided above.
  ***************************************************************************************   
-    MereTDD implementations and Macros
+    MereTDD declarations and Macros
  **************************************************************************************/
 #pragma once
 
-#include <map>
-#include <ostream>
+#include <iosfwd>
 #include <string_view>
 #include <vector>
 #include <string>
 #include <source_location>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <exception>
+#include <type_traits>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define MERETDD_HAS_MALLINFO2
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MERETDD_HAS_POSIX
+#endif
 
 namespace MereTDD
 {
@@ -80,80 +92,279 @@ namespace MereTDD
 	{
 	public:
 		ActualConfirmException(std::string_view expected, std::string_view actual, int line) :
-				ConfirmException(line),
-				m_expected(expected),
-				m_actual(actual)
+				ConfirmException(line)
 		{
-			format_reason();
+			format_reason(expected, actual);
 		}
 
 	private:
-		void format_reason()
+		void format_reason(std::string_view expected, std::string_view actual)
 		{
-			m_reason += "    Expected: " + m_expected + '\n';
-			m_reason += "    Actual  : " + m_actual;
+			m_reason.reserve(expected.size() + actual.size() + 27);
+			m_reason += "    Expected: ";
+			m_reason += expected;
+			m_reason += "\n    Actual  : ";
+			m_reason += actual;
 		}
+	};
 
-		std::string m_expected;
-		std::string m_actual;
-		int m_line{};
+	// Reports where two long strings or two containers first differ,
+	// with a bounded window around that point instead of both values.
+	class MismatchConfirmException : public ConfirmException
+	{
+	public:
+		MismatchConfirmException(std::string reason, int line) : ConfirmException(line)
+		{
+			m_reason = std::move(reason);
+		}
 	};
 
-	template<typename T>
-	class SetupAndTeardown : public T
+	// Names the corpus input a TEST_FUZZ body failed on.
+	class CorpusConfirmException : public ConfirmException
 	{
 	public:
-		SetupAndTeardown()
+		CorpusConfirmException(std::string reason, int line) : ConfirmException(line)
 		{
-			T::setup();
+			m_reason = std::move(reason);
 		}
+	};
 
-		~SetupAndTeardown()
+	class SnapshotConfirmException : public ConfirmException
+	{
+	public:
+		SnapshotConfirmException(std::string reason, int line) : ConfirmException(line)
 		{
-			T::teardown();
+			m_reason = std::move(reason);
 		}
 	};
 
-	inline std::map<std::string, std::vector<Test*>>& get_tests()
+	enum class ListMode
 	{
-		static std::map<std::string, std::vector<Test*>> tests;
+		none,
+		human,
+		json
+	};
 
-		return tests;
-	}
+	// Caps applied with setrlimit to the child process an isolated
+	// test runs in. Zero leaves the corresponding resource unlimited.
+	struct ResourceLimits
+	{
+		std::uint64_t address_space{};
+		std::uint64_t cpu_seconds{};
+		std::uint64_t open_files{};
+	};
 
-	inline std::map<std::string, std::vector<TestSuite*>>& get_test_suites()
+	enum class ResourceLimit
 	{
-		static std::map<std::string, std::vector<TestSuite*>> suites;
+		none,
+		address_space,
+		cpu_time,
+		open_files
+	};
 
-		return suites;
-	}
+	struct RunOptions
+	{
+		bool perf_counters{ false };
+		bool memory_usage{ false };
+		// Report the confirms each test made and how fast it made them.
+		bool checks{ false };
+		// Also time every CONFIRM call site and show the sites that
+		// take the most test time.
+		bool confirm_profile{ false };
+		ListMode list{ ListMode::none };
+		// Stop the run once this many failures have been seen. Zero
+		// means run everything.
+		int fail_fast{ 0 };
+		// Run each test in its own child process.
+		bool isolate{ false };
+		ResourceLimits limits;
+		// Rewrite golden files from the actual values instead of
+		// comparing against them.
+		bool update_snapshots{ false };
+		// Where golden files live. Empty means a snapshots directory
+		// next to the source file that holds the confirm.
+		std::string snapshot_dir;
+		// Where TEST_FUZZ seed inputs live. Empty means a corpus
+		// directory next to the source file that holds the test.
+		std::string corpus_dir;
+		// Run the registered benchmarks instead of the tests.
+		bool benchmark{ false };
+		// CPUs benchmarks are pinned to, for example "2" or "0,2-3".
+		// Empty leaves the affinity alone.
+		std::string benchmark_cpus;
+		bool benchmark_priority{ false };
+		int benchmark_samples{ 20 };
+		// File holding recent outcomes and durations of each test.
+		// When set, tests that failed lately and cheap tests run first
+		// and the file is updated after the run.
+		std::string history_file;
+		// Where run_tests writes its totals for a driver to merge.
+		std::string summary_file;
+		// Only run tests whose name or suite name contains this text.
+		std::string filter;
+		// Hand tests out to this many local worker processes instead of
+		// running them here.
+		int workers{ 0 };
+		// Where the coordinator accepts workers, "unix:<path>" or
+		// "tcp:<host>:<port>". Workers on other hosts join with
+		// --worker=<address>.
+		std::string listen_address;
+		// Run as a worker of the coordinator at this address.
+		std::string worker_address;
+	};
+
+	RunOptions& get_run_options();
 
-	inline void add_test(std::string_view suite_name, Test* test)
+	void parse_options(int argc, char* argv[]);
+
+	// Set when the run is being stopped early, either by --fail-fast or
+	// by an interrupt. Long-running test bodies can poll it and return.
+	class CancellationToken
 	{
-		std::string name(suite_name);
-		if (!get_tests().contains(name))
-		{
-			get_tests().try_emplace(name, std::vector<Test*>());
-		}
+	public:
+		// Atomic on the flag, kept out of line so this header does not
+		// need <atomic>.
+		bool cancelled() const;
 
-		get_tests()[name].push_back(test);
-	}
+		void cancel();
+
+		void reset();
+
+	private:
+		bool m_cancelled{ false };
+	};
+
+	CancellationToken& get_cancellation_token();
+
+	// A point-in-time view of the process footprint. Values that the
+	// platform cannot provide are left at zero.
+	struct MemorySample
+	{
+		std::int64_t resident{};
+		std::int64_t peak_resident{};
+		std::int64_t live_heap{};
+	};
+
+	MemorySample sample_memory();
+
+	struct MemoryUsage
+	{
+		bool sampled{ false };
+		std::int64_t resident_delta{};
+		std::int64_t peak_resident{};
+		std::int64_t peak_growth{};
+		std::int64_t leaked_heap{};
+	};
+
+	// Confirms made at one call site while profiling. The time covers
+	// evaluating the arguments of a CONFIRM macro as well as the check.
+	struct ConfirmSite
+	{
+		std::string file;
+		int line{};
+		std::uint64_t checks{};
+		std::int64_t ns{};
+	};
+
+	struct CheckStats
+	{
+		std::uint64_t checks{};
+		// Time spent in the test body, to turn checks into a rate.
+		std::int64_t body_ns{};
+		std::vector<ConfirmSite> sites;
+	};
+
+	// Live heap bytes left behind by SetupAndTeardown fixtures in the
+	// test that is currently running. The runner resets it per test.
+	std::int64_t& get_fixture_leaked_bytes();
+
+	struct ArenaUsage
+	{
+		std::uint64_t allocations{};
+		std::uint64_t bytes_allocated{};
+		// Bytes taken from the heap beyond the arena's own first block.
+		std::uint64_t bytes_reserved{};
+	};
+
+	class TestArena;
+
+	// The arena of the test that is currently running. Include arena.h
+	// to use it.
+	TestArena& get_test_arena();
+
+	// Constructed before and destroyed after the fixture policy, so the
+	// live heap comparison covers the policy's own members as well.
+	class FixtureLeakCheck
+	{
+	public:
+		FixtureLeakCheck();
+
+		FixtureLeakCheck(FixtureLeakCheck const&) = delete;
 
-	inline void add_test_suite(std::string_view suite_name, TestSuite* suite)
+		FixtureLeakCheck& operator=(FixtureLeakCheck const&) = delete;
+
+		~FixtureLeakCheck();
+
+	private:
+		bool m_enabled;
+		int m_uncaught;
+		MemorySample m_before;
+		std::uint64_t m_arena_before{};
+	};
+
+	// A fixture whose setup takes a memory resource is handed the
+	// test's arena, as long as arena.h is included.
+	template<typename T>
+	class SetupAndTeardown : private FixtureLeakCheck, public T
 	{
-		std::string name(suite_name);
-		if (!get_test_suites().contains(name))
+	public:
+		SetupAndTeardown()
 		{
-			get_test_suites().try_emplace(name, std::vector<TestSuite*>());
+			if constexpr (requires(T& fixture, TestArena* arena) { fixture.setup(arena); })
+			{
+				T::setup(&get_test_arena());
+			}
+			else
+			{
+				T::setup();
+			}
 		}
-		get_test_suites()[name].push_back(suite);
-	}
+
+		~SetupAndTeardown()
+		{
+			T::teardown();
+		}
+	};
+
+	void add_test(std::string_view suite_name, Test* test);
+
+	void add_test_suite(std::string_view suite_name, TestSuite* suite);
+
+	// Tests, fixtures and benchmarks take themselves out of the registry
+	// when they are destroyed, so ones created in a narrower scope than
+	// the program never leave a dangling entry behind.
+	void remove_test(std::string_view suite_name, Test* test);
+
+	void remove_test_suite(TestSuite* suite);
+
+	struct PerfCount
+	{
+		std::string name;
+		std::uint64_t value{};
+	};
+
+	class VirtualClock;
+
+	// The virtual clock of the running test. The runner resets it
+	// before every test.
+	VirtualClock& get_test_clock();
 
 	class TestBase
 	{
 	public:
-		explicit TestBase(std::string_view name, std::string_view suite_name) :
-				m_name(name), m_suite_name(suite_name)
+		explicit TestBase(std::string_view name, std::string_view suite_name,
+				const std::source_location location = std::source_location::current()) :
+				m_name(name), m_suite_name(suite_name), m_location(location)
 		{
 		}
 
@@ -176,11 +387,35 @@ namespace MereTDD
 			return m_suite_name;
 		}
 
+		std::source_location const& location() const
+		{
+			return m_location;
+		}
+
 		bool passed() const
 		{
 			return m_passed;
 		}
 
+		bool cancellation_requested() const
+		{
+			return get_cancellation_token().cancelled();
+		}
+
+		// A virtual clock the runner resets before every test. Include
+		// clock.h to use it.
+		VirtualClock& clock() const
+		{
+			return get_test_clock();
+		}
+
+		// Released in one step after the test returns. Include arena.h
+		// to use it.
+		TestArena* arena() const
+		{
+			return &get_test_arena();
+		}
+
 		std::string_view reason() const
 		{
 			return m_reason;
@@ -203,28 +438,111 @@ namespace MereTDD
 			m_confirm_location = confirm_location;
 		}
 
+		// A fixture is set up again after a failed setup, so the old
+		// failure must not stick to it.
+		void clear_failure()
+		{
+			m_passed = true;
+			m_reason.clear();
+			m_confirm_location = -1;
+		}
+
 		void set_expected_failure_reason(std::string_view reason)
 		{
 			m_expected_reason = reason;
 		}
 
+		ResourceLimits const& resource_limits() const
+		{
+			return m_resource_limits;
+		}
+
+		// Tightens the limits of the child process this test runs in.
+		// Tests running inside the runner process are not limited.
+		void limit_resources(ResourceLimits const& limits);
+
+		ResourceLimit limit_exceeded() const
+		{
+			return m_limit_exceeded;
+		}
+
+		void set_limit_exceeded(ResourceLimit limit, std::string_view reason)
+		{
+			set_failed(reason);
+			m_limit_exceeded = limit;
+		}
+
+		std::vector<PerfCount> const& perf_counts() const
+		{
+			return m_perf_counts;
+		}
+
+		void set_perf_counts(std::vector<PerfCount> counts)
+		{
+			m_perf_counts = std::move(counts);
+		}
+
+		MemoryUsage const& memory_usage() const
+		{
+			return m_memory_usage;
+		}
+
+		void set_memory_usage(MemoryUsage const& usage)
+		{
+			m_memory_usage = usage;
+		}
+
+		CheckStats const& check_stats() const
+		{
+			return m_check_stats;
+		}
+
+		void set_check_stats(CheckStats stats)
+		{
+			m_check_stats = std::move(stats);
+		}
+
+		ArenaUsage const& arena_usage() const
+		{
+			return m_arena_usage;
+		}
+
+		void set_arena_usage(ArenaUsage const& usage)
+		{
+			m_arena_usage = usage;
+		}
+
 	private:
 		std::string m_name;
 		std::string m_suite_name;
+		std::source_location m_location;
 		bool m_passed{ true };
 		std::string m_reason;
 		std::string m_expected_reason;
 		int m_confirm_location{ -1 };
+		std::vector<PerfCount> m_perf_counts;
+		MemoryUsage m_memory_usage;
+		ArenaUsage m_arena_usage;
+		CheckStats m_check_stats;
+		ResourceLimits m_resource_limits;
+		ResourceLimit m_limit_exceeded{ ResourceLimit::none };
 	};
 
 	class Test : public TestBase
 	{
 	public:
-		Test(std::string_view name, std::string_view suite_name) : TestBase(name, suite_name)
+		Test(std::string_view name, std::string_view suite_name,
+				const std::source_location location = std::source_location::current()) :
+				TestBase(name, suite_name, location)
 		{
 			add_test(suite_name, this);
 		}
 
+		~Test() override
+		{
+			remove_test(suite_name(), this);
+		}
+
 		virtual void run_ex()
 		{
 			run();
@@ -232,6 +550,13 @@ namespace MereTDD
 
 		virtual void run() = 0;
 
+		// The type a TEST_EX or TEST_SUITE_EX expects to be thrown, or
+		// empty for tests that are not expected to throw.
+		virtual std::string_view exception_name() const
+		{
+			return {};
+		}
+
 		std::string_view expected_reason() const
 		{
 			return m_expected_reason;
@@ -250,9 +575,15 @@ namespace MereTDD
 	class TestEx : public Test
 	{
 	public:
-		TestEx(std::string_view name, std::string_view suite_name, std::string_view exception_name) :
-				Test(name, suite_name), m_exception_name(exception_name)
+		TestEx(std::string_view name, std::string_view suite_name, std::string_view exception_name,
+				const std::source_location location = std::source_location::current()) :
+				Test(name, suite_name, location), m_exception_name(exception_name)
+		{
+		}
+
+		std::string_view exception_name() const override
 		{
+			return m_exception_name;
 		}
 
 		void run_ex() override
@@ -273,241 +604,334 @@ namespace MereTDD
 		std::string m_exception_name;
 	};
 
-	class TestSuite : public TestBase
+	// A test whose body takes raw input. Regular runs feed it every file
+	// in its seed corpus directory, <corpus>/<name with non-alphanumeric
+	// characters replaced by '_'>. Built with MERETDD_FUZZ the same body
+	// becomes a libFuzzer target.
+	class FuzzTest : public Test
 	{
 	public:
-		TestSuite(std::string_view name, std::string_view suite_name) : TestBase(name, suite_name)
+		FuzzTest(std::string_view name, std::string_view suite_name,
+				const std::source_location location = std::source_location::current()) :
+				Test(name, suite_name, location)
 		{
-			add_test_suite(suite_name, this);
 		}
 
-		virtual void suite_setup() = 0;
+		void run() override;
 
-		virtual void suite_teardown() = 0;
+		virtual void run_input(const std::uint8_t* data, std::size_t size) = 0;
 	};
 
-	template<typename T>
-	class TestSuiteSetupAndTeardown : public T, public TestSuite
+	class Benchmark;
+
+	void add_benchmark(Benchmark* benchmark);
+
+	void remove_benchmark(Benchmark* benchmark);
+
+	// Timing of one benchmark. All times are per iteration.
+	struct BenchmarkResult
+	{
+		std::size_t warmup_samples{};
+		std::size_t samples{};
+		std::size_t iterations{};
+		double median_ns{};
+		double mean_ns{};
+		double stddev_ns{};
+		double min_ns{};
+		// Relative change of a fixed calibration loop measured before
+		// and after the samples. Large values mean the CPU changed speed.
+		double calibration_drift{};
+		std::int64_t frequency_before_khz{};
+		std::int64_t frequency_after_khz{};
+		std::int64_t throttle_events{};
+	};
+
+	// The body is one iteration. Benchmarks only run with --benchmark.
+	class Benchmark : public TestBase
 	{
 	public:
-		TestSuiteSetupAndTeardown(std::string_view name, std::string_view suite) : TestSuite(name, suite)
+		explicit Benchmark(std::string_view name,
+				const std::source_location location = std::source_location::current()) :
+				TestBase(name, "", location)
 		{
+			add_benchmark(this);
 		}
 
-		void run() override
-		{}
+		~Benchmark() override
+		{
+			remove_benchmark(this);
+		}
 
-		void suite_setup() override
+		BenchmarkResult const& result() const
 		{
-			T::setup();
+			return m_result;
 		}
 
-		void suite_teardown() override
+		void set_result(BenchmarkResult const& result)
 		{
-			T::teardown();
+			m_result = result;
 		}
+
+	private:
+		BenchmarkResult m_result;
 	};
 
-	inline void run_test(std::ostream& output, Test* test, int& num_passed, int& num_failed, int& num_missed_failed)
+	// Keeps the compiler from discarding a value computed in a benchmark.
+	template<typename T>
+	inline void do_not_optimize(T const& value)
 	{
-		output << "------- Test: "
-			   << test->name()
-			   << std::endl;
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static_cast<void>(*static_cast<volatile char const*>(static_cast<void const*>(&value)));
+#endif
+	}
 
-		try
+	class TestSuite : public TestBase
+	{
+	public:
+		TestSuite(std::string_view name, std::string_view suite_name,
+				const std::source_location location = std::source_location::current()) :
+				TestBase(name, suite_name, location)
 		{
-			test->run_ex();
+			add_test_suite(suite_name, this);
 		}
-		catch (const ConfirmException& ex)
+
+		// One fixture serving several suites. It is set up once for all
+		// of them.
+		TestSuite(std::string_view name, std::initializer_list<std::string_view> suite_names,
+				const std::source_location location = std::source_location::current()) :
+				TestBase(name, suite_names.size() == 0 ? std::string_view() : *suite_names.begin(), location)
 		{
-			test->set_failed(ex.reason(), ex.line());
+			for (auto suite_name: suite_names)
+			{
+				add_test_suite(suite_name, this);
+			}
 		}
-		catch (const MissingException& ex)
+
+		~TestSuite() override
 		{
-			std::string message = "Expected exception type ";
-			message += ex.ex_type();
-			message += " was not thrown.";
-			test->set_failed(message);
+			remove_test_suite(this);
 		}
-		catch (...)
+
+		virtual void suite_setup() = 0;
+
+		virtual void suite_teardown() = 0;
+
+		MemorySample const& setup_sample() const
 		{
-			test->set_failed("Unexpected exception thrown.");
+			return m_setup_sample;
 		}
 
-		if (test->passed())
+		void set_setup_sample(MemorySample const& sample)
 		{
-			if (!test->expected_reason().empty())
-			{
-				// This test passed, but it was supposed
-				// to have failed.
-				++num_missed_failed;
-				output << "Missed expected failure\n"
-					   << "Test passed but was expected to fail."
-					   << std::endl;
-			}
-			else
-			{
-				++num_passed;
-				output << "Passed" << std::endl;
-			}
+			m_setup_sample = sample;
 		}
-		else if (!test->expected_reason().empty() && test->expected_reason() == test->reason())
+
+		// Live heap bytes suite_setup() itself left allocated. Heap the
+		// suite's tests leave behind is not the fixture's doing.
+		std::int64_t setup_heap() const
 		{
-			++num_passed;
-			output << "Expected failure\n"
-				   << test->reason()
-				   << std::endl;
+			return m_setup_heap;
 		}
-		else
+
+		void set_setup_heap(std::int64_t bytes)
 		{
-			++num_failed;
-			if (test->confirm_location() != -1)
-			{
-				output << "Failed confirm on line "
-					   << test->confirm_location() << '\n';
-			}
-			else
-			{
-				output << "Failed\n";
-			}
+			m_setup_heap = bytes;
+		}
 
-			output << test->reason() << std::endl;
+		bool is_set_up() const
+		{
+			return m_set_up;
 		}
-	}
 
-	inline bool run_suite(std::ostream& output, bool setup, const std::string& name, int& num_passed, int& num_failed)
-	{
-		for (auto& suite: get_test_suites()[name])
+		void set_set_up(bool set_up)
 		{
-			if (setup)
-			{
-				output << "------- Setup: ";
-			}
-			else
-			{
-				output << "------- Teardown: ";
-			}
-			output << suite->name() << std::endl;
+			m_set_up = set_up;
+		}
 
-			try
-			{
-				if (setup)
-				{
-					suite->suite_setup();
-				}
-				else
-				{
-					suite->suite_teardown();
-				}
-			}
-			catch (const ConfirmException& ex)
-			{
-				suite->set_failed(ex.reason(), ex.line());
-			}
-			catch (...)
-			{
-				suite->set_failed("Unexpected exception thrown.");
-			}
+		// Selected tests that still need this fixture, or on a worker
+		// the suites it serves there. The fixture is set up on demand
+		// and torn down once none are left.
+		void retain(int count = 1)
+		{
+			m_users += count;
+		}
 
-			if (suite->passed())
-			{
-				++num_passed;
-				output << "Passed" << std::endl;
-			}
-			else
-			{
-				++num_failed;
-				if (suite->confirm_location() != -1)
-				{
-					output << "Failed confirm on line "
-						   << suite->confirm_location() << '\n';
-				}
-				else
-				{
-					output << "Failed\n";
-				}
-				output << suite->reason() << std::endl;
-				return false;
-			}
+		void release(int count = 1)
+		{
+			m_users -= count;
 		}
-		return true;
-	}
 
-	inline int run_tests(std::ostream& output)
+		int users() const
+		{
+			return m_users;
+		}
+
+	private:
+		MemorySample m_setup_sample;
+		std::int64_t m_setup_heap{};
+		int m_users{ 0 };
+		bool m_set_up{ false };
+	};
+
+	void set_suite_resource_limits(std::string_view suite_name, ResourceLimits const& limits);
+
+	// Declared next to a suite's TestSuiteSetupAndTeardown objects to
+	// run every test of that suite isolated under the given limits.
+	class SuiteResourceLimits
 	{
-		output << "Running "
-			   << get_tests().size()
-			   << " tests\n";
+	public:
+		SuiteResourceLimits(std::string_view suite_name, ResourceLimits const& limits)
+		{
+			set_suite_resource_limits(suite_name, limits);
+		}
+	};
 
-		int num_passed = 0;
-		int num_missed_failed = 0;
-		int num_failed = 0;
+	template<typename T>
+	class TestSuiteSetupAndTeardown : public T, public TestSuite
+	{
+	public:
+		TestSuiteSetupAndTeardown(std::string_view name, std::string_view suite,
+				const std::source_location location = std::source_location::current()) :
+				TestSuite(name, suite, location)
+		{
+		}
 
-		for (auto const& [key, value]: get_tests())
+		TestSuiteSetupAndTeardown(std::string_view name, std::initializer_list<std::string_view> suites,
+				const std::source_location location = std::source_location::current()) :
+				TestSuite(name, suites, location)
 		{
-			std::string suite_display_name = "Suite: ";
-			if (key.empty())
-			{
-				suite_display_name += "Single Tests";
-			}
-			else
-			{
-				suite_display_name += key;
-			}
-			output << "---------------- " << suite_display_name << std::endl;
+		}
 
-			if (!key.empty())
-			{
-				if (!get_test_suites().contains(key))
-				{
-					output << "Test suite is not found."
-						   << " Exiting test application."
-						   << std::endl;
-					return ++num_failed;
-				}
+		void run() override
+		{}
 
-				if (!run_suite(output, true, key, num_passed, num_failed))
-				{
-					output << "Test suite setup failed."
-						   << " Skipping tests in suite."
-						   << std::endl;
+		void suite_setup() override
+		{
+			T::setup();
+		}
 
-					continue;
-				}
-			}
+		void suite_teardown() override
+		{
+			T::teardown();
+		}
+	};
 
-			for (auto* test: value)
-			{
-				run_test(output, test, num_passed, num_failed, num_missed_failed);
-			}
+	void run_test(std::ostream& output, Test* test, int& num_passed, int& num_failed, int& num_missed_failed);
+
+	// Sets up the suite's fixtures that are not set up yet, or tears
+	// down the ones no selected test needs any more.
+	bool run_suite(std::ostream& output, bool setup, const std::string& name, int& num_passed, int& num_failed);
+
+	// Writes every registered suite, fixture and test without running
+	// anything. Used by --list and --list=json.
+	void list_tests(std::ostream& output, ListMode mode);
+
+	int run_benchmarks(std::ostream& output);
+
+	// Accepts lists such as "0,2-3". A list with a CPU that a cpu_set_t
+	// cannot hold, or with a range running backwards, comes back empty.
+	std::vector<int> parse_cpu_list(std::string_view text);
+
+	// Standard deviation over mean, or zero when the mean is zero.
+	double coefficient_of_variation(std::vector<double> const& values);
+
+	// Warms the benchmark up until its timings settle, then takes the
+	// given number of samples. Frequency and throttling are read from
+	// the given CPUs, which are the ones the runner may run on.
+	BenchmarkResult measure_benchmark(Benchmark* benchmark, int samples, std::vector<int> const& cpus = {});
+
+	// Writes the timings and warns when the CPU changed speed or was
+	// throttled while sampling.
+	void report_benchmark(std::ostream& output, Benchmark const* benchmark);
+
+	int run_tests(std::ostream& output);
+
+	int run_tests(std::ostream& output, int argc, char* argv[]);
+
+	// The totals that end a run_tests report.
+	struct RunSummary
+	{
+		int passed{};
+		int failed{};
+		int missed_failed{};
+		int over_limit{};
+		std::size_t not_run{};
+	};
+
+	void report_summary(std::ostream& output, RunSummary const& summary);
 
-			if (!key.empty())
+	// The totals as one "name value" line each, so a driver running
+	// several test executables can add them up.
+	bool write_summary(std::string const& path, RunSummary const& summary);
+
+	bool read_summary(std::string const& path, RunSummary& summary);
+
+	// Compares actual against the golden file <name>.snap and reports only
+	// the changed lines on a mismatch.
+	void confirm_snapshot(std::string_view name, std::string_view actual,
+			const std::source_location location = std::source_location::current());
+
+	// Confirms made by the running test. The runner resets it per test.
+	std::uint64_t get_confirm_count();
+
+	// Mirrors RunOptions::confirm_profile for the hot path. Only the
+	// runner sets it, and never while a test body runs.
+	inline bool& get_confirm_profiling()
+	{
+		static bool profiling = false;
+
+		return profiling;
+	}
+
+	// Nanoseconds on a steady clock, kept out of line so this header
+	// does not need <chrono>.
+	std::int64_t confirm_clock_ns();
+
+	void record_confirm_time(std::source_location const& location, std::int64_t elapsed_ns);
+
+	// A relaxed load and store instead of an increment keeps locked
+	// instructions out of every confirm. Confirms racing on several
+	// threads may be undercounted. Kept out of line so this header does
+	// not need <atomic>.
+	void count_confirm(std::source_location const& location);
+
+	// The CONFIRM macros create one ahead of the call, so when profiling
+	// the time spent evaluating the arguments is charged to the site too.
+	class ConfirmProbe
+	{
+	public:
+		explicit ConfirmProbe(const std::source_location location = std::source_location::current()) :
+				m_location(location)
+		{
+			if (get_confirm_profiling())
 			{
-				if (!run_suite(output, false, key, num_passed, num_failed))
-				{
-					output << "Test suite teardown failed." << std::endl;
-				}
+				m_start = confirm_clock_ns();
 			}
 		}
 
-		output << "-----------------------------------\n";
+		ConfirmProbe(ConfirmProbe const&) = delete;
 
-		output << "Tests passed: " << num_passed
-			   << "\nTests failed: " << num_failed;
+		ConfirmProbe& operator=(ConfirmProbe const&) = delete;
 
-		if (num_missed_failed != 0)
+		~ConfirmProbe()
 		{
-			output << "\nTests failures missed: " << num_missed_failed;
+			if (m_start != -1)
+			{
+				record_confirm_time(m_location, confirm_clock_ns() - m_start);
+			}
 		}
 
-		output << std::endl;
-
-		return num_failed;
-	}
+	private:
+		std::source_location m_location;
+		std::int64_t m_start{ -1 };
+	};
 
 	inline void
 	confirm(bool expected, bool actual, const std::source_location location = std::source_location::current())
 	{
+		count_confirm(location);
 		if (actual != expected)
 		{
 			throw BoolConfirmException(expected, location.line());
@@ -518,30 +942,123 @@ namespace MereTDD
 	void
 	confirm(const T& expected, const T& actual, const std::source_location location = std::source_location::current())
 	{
+		count_confirm(location);
 		if (actual != expected)
 		{
 			throw ActualConfirmException(std::to_string(expected), std::to_string(actual), location.line());
 		}
 	}
 
+	// Strings up to this many bytes are reported in full. Longer ones
+	// only show this many bytes on either side of the first difference.
+	inline constexpr std::size_t mismatch_window = 32;
+
+	[[noreturn]] void throw_string_mismatch(std::string_view expected, std::string_view actual, int line);
+
+	[[noreturn]] void throw_container_mismatch(std::size_t index, std::size_t expected_size, std::size_t actual_size,
+			std::size_t window_start, std::vector<std::string> const& expected_window,
+			std::vector<std::string> const& actual_window, int line);
+
 	inline void confirm(std::string_view expected, std::string_view actual,
 			const std::source_location location = std::source_location::current())
 	{
+		count_confirm(location);
 		if (actual != expected)
 		{
-			throw ActualConfirmException(expected, actual, location.line());
+			throw_string_mismatch(expected, actual, location.line());
 		}
 	}
 
 	inline void confirm(const std::string& expected, const std::string& actual,
 			const std::source_location location = std::source_location::current())
 	{
-		confirm(std::string_view(expected), std::string_view(actual));
+		count_confirm(location);
+		if (actual != expected)
+		{
+			throw_string_mismatch(expected, actual, location.line());
+		}
+	}
+
+	template<typename T>
+	std::string format_element(const T& value)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+		{
+			return value ? "true" : "false";
+		}
+		else if constexpr (std::is_arithmetic_v<T>)
+		{
+			return std::to_string(value);
+		}
+		else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+		{
+			std::string_view text(value);
+			std::string formatted = "\"";
+			formatted += text.substr(0, mismatch_window);
+			formatted += text.size() > mismatch_window ? "...\"" : "\"";
+			return formatted;
+		}
+		else
+		{
+			return "?";
+		}
+	}
+
+	// Containers are compared element by element. Only the elements
+	// around the first difference are formatted for the report.
+	template<typename T>
+	requires requires(const T& container)
+	{
+		container.begin();
+		container.end();
+		container.size();
+	}
+	void confirm(const T& expected, const T& actual, const std::source_location location = std::source_location::current())
+	{
+		constexpr std::size_t window = 3;
+
+		count_confirm(location);
+		std::size_t index = 0;
+		auto expected_it = expected.begin();
+		auto actual_it = actual.begin();
+		while (expected_it != expected.end() && actual_it != actual.end() && *expected_it == *actual_it)
+		{
+			++expected_it;
+			++actual_it;
+			++index;
+		}
+		if (expected_it == expected.end() && actual_it == actual.end())
+		{
+			return;
+		}
+
+		std::size_t window_start = index > window ? index - window : 0;
+		auto collect = [&](const T& container)
+		{
+			std::vector<std::string> elements;
+			std::size_t position = 0;
+			for (auto const& element: container)
+			{
+				if (position > index + window)
+				{
+					break;
+				}
+				if (position >= window_start)
+				{
+					elements.push_back(format_element(element));
+				}
+				++position;
+			}
+			return elements;
+		};
+		throw_container_mismatch(index, expected.size(), actual.size(), window_start,
+				collect(expected), collect(actual), location.line());
 	}
 
 	inline void
 	confirm(double expected, double actual, const std::source_location location = std::source_location::current())
 	{
+		count_confirm(location);
 		if (actual < (expected - 0.000001) || actual > (expected + 0.000001))
 		{
 			throw ActualConfirmException(std::to_string(expected), std::to_string(actual), location.line());
@@ -551,6 +1068,7 @@ namespace MereTDD
 	inline void confirm(long double expected, long double actual,
 			const std::source_location location = std::source_location::current())
 	{
+		count_confirm(location);
 		if (actual < (expected - 0.000001) || actual > (expected + 0.000001))
 		{
 			throw ActualConfirmException(std::to_string(expected), std::to_string(actual), location.line());
@@ -560,6 +1078,7 @@ namespace MereTDD
 	inline void
 	confirm(float expected, float actual, const std::source_location location = std::source_location::current())
 	{
+		count_confirm(location);
 		if (actual < (expected - 0.0001f) || actual > (expected + 0.0001f))
 		{
 			throw ActualConfirmException(std::to_string(expected), std::to_string(actual), location.line());
@@ -578,11 +1097,11 @@ namespace MereTDD
 
 #define TEST(test_name) \
 namespace {\
-class MERETDD_CLASS : public MereTDD::TestBase \
+class MERETDD_CLASS : public MereTDD::Test \
 {            \
 public:      \
     MERETDD_CLASS (std::string_view name)              \
-        : TestBase(name)                      \
+        : Test(name, "")                      \
         { }          \
         void run() override;                     \
 };                      \
@@ -593,11 +1112,11 @@ void MERETDD_CLASS::run()
 
 #define TEST_EX(test_name, exception_type) \
 namespace {\
-class MERETDD_CLASS : public MereTDD::TestExBase<exception_type> \
+class MERETDD_CLASS : public MereTDD::TestEx<exception_type> \
 {                                          \
 public:                                    \
     MERETDD_CLASS (std::string_view name, std::string_view exception_name)     \
-        : TestExBase(name, exception_name)                         \
+        : TestEx(name, "", exception_name)                         \
         { }                                        \
 \
         void run() override;                    \
@@ -631,15 +1150,42 @@ public:                                                      \
 MERETDD_CLASS MERETDD_INSTANCE(test_name, suite_name, #exception_type);                                                              \
 void MERETDD_CLASS::run()
 
+#define BENCHMARK(benchmark_name) \
+namespace {                      \
+class MERETDD_CLASS : public MereTDD::Benchmark \
+{                                \
+public:                          \
+    MERETDD_CLASS (std::string_view name): Benchmark(name) {} \
+    void run() override;         \
+};                               \
+}                                \
+MERETDD_CLASS MERETDD_INSTANCE(benchmark_name); \
+void MERETDD_CLASS::run()
+
+#define TEST_FUZZ(test_name, data_param, size_param) \
+namespace {                                           \
+class MERETDD_CLASS : public MereTDD::FuzzTest        \
+{                                                     \
+public:                                               \
+    MERETDD_CLASS (std::string_view name): FuzzTest(name, "") {} \
+    void run_input(data_param, size_param) override;  \
+};                                                    \
+}                                                     \
+MERETDD_CLASS MERETDD_INSTANCE(test_name);            \
+void MERETDD_CLASS::run_input(data_param, size_param)
+
 
 #define CONFIRM_FALSE(actual) \
-    MereTDD::confirm(false, actual)
+    (MereTDD::ConfirmProbe(), MereTDD::confirm(false, actual))
 
 #define CONFIRM_TRUE(actual)  \
-    MereTDD::confirm(true, actual)
+    (MereTDD::ConfirmProbe(), MereTDD::confirm(true, actual))
 
 #define CONFIRM(expected, actual) \
-    MereTDD::confirm(expected, actual)
+    (MereTDD::ConfirmProbe(), MereTDD::confirm(expected, actual))
+
+#define CONFIRM_SNAPSHOT(name, actual) \
+    (MereTDD::ConfirmProbe(), MereTDD::confirm_snapshot(name, actual))
 
 
 
@@ -1,7 +1,7 @@
 #include <iostream>
 #include "../test.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-	return MereTDD::run_tests(std::cout);
+	return MereTDD::run_tests(std::cout, argc, argv);
 }
@@ -0,0 +1,89 @@
+/***************************************************************************************
+    File: nested_run.h
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Helpers for tests that drive a nested run of tests created inside a test
+ **************************************************************************************/
+#pragma once
+
+#include "../test.h"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A test whose body is given when it is created. Tests like this only
+// exist while the test that creates them runs, so they never take
+// part in the outer run.
+class LocalTest : public MereTDD::Test
+{
+public:
+	LocalTest(std::string_view name, std::string_view suite, std::function<void()> body,
+			const std::source_location location = std::source_location::current()) :
+			Test(name, suite, location), m_body(std::move(body))
+	{
+	}
+
+	void run() override
+	{
+		m_body();
+	}
+
+private:
+	std::function<void()> m_body;
+};
+
+// Runs the registered tests with only the given options and returns
+// the report. The options and the cancellation state of the outer
+// run are put back afterwards.
+inline std::string run_nested(std::vector<std::string> arguments)
+{
+	auto saved = MereTDD::get_run_options();
+	MereTDD::get_run_options() = {};
+
+	std::vector<char*> argv{ const_cast<char*>("Tests") };
+	for (auto& argument: arguments)
+	{
+		argv.push_back(argument.data());
+	}
+
+	std::ostringstream output;
+	MereTDD::run_tests(output, static_cast<int>(argv.size()), argv.data());
+
+	MereTDD::get_run_options() = saved;
+	MereTDD::get_confirm_profiling() = saved.confirm_profile;
+	MereTDD::get_cancellation_token().reset();
+	return output.str();
+}
+
+inline bool contains(std::string const& text, std::string_view part)
+{
+	return text.find(part) != std::string::npos;
+}
+
+// A path in the temporary directory that does not exist yet.
+inline std::filesystem::path temporary_path(std::string_view name)
+{
+	auto path = std::filesystem::temp_directory_path() / name;
+	std::filesystem::remove_all(path);
+	return path;
+}
+
+inline std::string read_file(std::filesystem::path const& path)
+{
+	std::ifstream file(path);
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
@@ -33,3 +33,15 @@ TEST_EX("Test with throw can be created", int)
 TEST_EX("Test that never throws can be created", int)
 {
 }
+
+TEST("Test body can observe cancellation")
+{
+	CONFIRM_FALSE(cancellation_requested());
+
+	auto& token = MereTDD::get_cancellation_token();
+	token.cancel();
+	bool cancelled = cancellation_requested();
+	token.reset();
+
+	CONFIRM_TRUE(cancelled);
+}
@@ -14,6 +14,9 @@
 
 #include "../test.h"
 
+#include <string>
+#include <vector>
+
 bool is_passing_grade(int value)
 {
 	if (value < 60) return false;
@@ -189,4 +192,60 @@ TEST("Test int confirms")
 	CONFIRM(0, multiply_by_2(0));
 	CONFIRM(2, multiply_by_2(1));
 	CONFIRM(-2, multiply_by_2(-1));
-}
\ No newline at end of file
+}
+
+TEST("Test long string confirm failure shows first difference")
+{
+	std::string reason = "    Mismatch at offset 5000 (expected length 10000, actual length 10000)\n";
+	reason += "    Expected: ...\"" + std::string(32, 'a') + std::string(32, 'a') + "\"...\n";
+	reason += "    Actual  : ...\"" + std::string(32, 'a') + 'b' + std::string(31, 'a') + "\"...";
+	set_expected_failure_reason(reason);
+
+	std::string expected(10'000, 'a');
+	std::string result = expected;
+	result[5000] = 'b';
+	CONFIRM(expected, result);
+}
+
+TEST("Test long string confirm failure with different lengths")
+{
+	std::string reason = "    Mismatch at offset 40 (expected length 40, actual length 41)\n";
+	reason += "    Expected: ...\"" + std::string(24, '-') + "abcdefgh\"\n";
+	reason += "    Actual  : ...\"" + std::string(24, '-') + "abcdefgh\\n\"";
+	set_expected_failure_reason(reason);
+
+	std::string expected = std::string(32, '-') + "abcdefgh";
+	CONFIRM(expected, expected + "\n");
+}
+
+TEST("Test vector confirms")
+{
+	std::vector<int> result{ 1, 2, 3 };
+	std::vector<int> expected{ 1, 2, 3 };
+	CONFIRM(expected, result);
+}
+
+TEST("Test vector confirm failure")
+{
+	std::string reason = "    Mismatch at index 5 (expected size 8, actual size 8)\n";
+	reason += "    Expected: [..., 2, 3, 4, 5, 6, 7]\n";
+	reason += "    Actual  : [..., 2, 3, 4, 50, 6, 7]";
+	set_expected_failure_reason(reason);
+
+	std::vector<int> expected{ 0, 1, 2, 3, 4, 5, 6, 7 };
+	std::vector<int> result = expected;
+	result[5] = 50;
+	CONFIRM(expected, result);
+}
+
+TEST("Test vector confirm failure with missing elements")
+{
+	std::string reason = "    Mismatch at index 2 (expected size 3, actual size 2)\n";
+	reason += "    Expected: [\"a\", \"b\", \"c\"]\n";
+	reason += "    Actual  : [\"a\", \"b\"]";
+	set_expected_failure_reason(reason);
+
+	std::vector<std::string> expected{ "a", "b", "c" };
+	std::vector<std::string> result{ "a", "b" };
+	CONFIRM(expected, result);
+}
@@ -0,0 +1,98 @@
+/***************************************************************************************
+    File: tests_arena.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Per-test arena allocator
+ **************************************************************************************/
+
+#include "../test.h"
+#include "../arena.h"
+
+#include <list>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct Node
+{
+	int value;
+	std::pmr::vector<Node*> children;
+};
+
+class ArenaGraph
+{
+public:
+	void setup(std::pmr::memory_resource* arena)
+	{
+		// Polymorphic allocators do not move with the container, so
+		// the list is built in place on the arena.
+		m_nodes.emplace(arena);
+		for (int i = 0; i < 100; ++i)
+		{
+			m_nodes->push_back({ i, std::pmr::vector<Node*>(arena) });
+		}
+	}
+
+	void teardown()
+	{
+	}
+
+	std::pmr::list<Node>& nodes()
+	{
+		return *m_nodes;
+	}
+
+private:
+	std::optional<std::pmr::list<Node>> m_nodes;
+};
+
+TEST("Test arena starts empty for every test")
+{
+	CONFIRM(0, static_cast<int>(MereTDD::get_test_arena().usage().allocations));
+}
+
+TEST("Test body can build a graph in the arena")
+{
+	std::pmr::list<Node> nodes(arena());
+	for (int i = 0; i < 10000; ++i)
+	{
+		nodes.push_back({ i, std::pmr::vector<Node*>(arena()) });
+		if (i > 0)
+		{
+			std::prev(nodes.end(), 2)->children.push_back(&nodes.back());
+		}
+	}
+
+	CONFIRM(9999, nodes.back().value);
+	// One allocation per node and one per child list.
+	CONFIRM(19999, static_cast<int>(MereTDD::get_test_arena().usage().allocations));
+}
+
+TEST("Test arena is empty again after a large test")
+{
+	CONFIRM(0, static_cast<int>(MereTDD::get_test_arena().usage().bytes_reserved));
+}
+
+TEST("Test fixture setup is handed the arena")
+{
+	MereTDD::SetupAndTeardown<ArenaGraph> graph;
+
+	CONFIRM(100, static_cast<int>(graph.nodes().size()));
+	CONFIRM_TRUE(graph.nodes().get_allocator().resource() == arena());
+}
+
+TEST("Test arena strings outlive nothing but the test")
+{
+	std::pmr::string text("a string long enough to need the heap", arena());
+	text += text;
+
+	CONFIRM_TRUE(MereTDD::get_test_arena().usage().bytes_allocated >= text.size());
+}
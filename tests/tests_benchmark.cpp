@@ -0,0 +1,154 @@
+/***************************************************************************************
+    File: tests_benchmark.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Benchmarks, only run with --benchmark, and tests of how they are measured
+ **************************************************************************************/
+
+#include "../test.h"
+
+#include <chrono>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Each iteration takes at least 100 microseconds, which bounds how
+	// many fit in a sample.
+	class SpinBenchmark : public MereTDD::Benchmark
+	{
+	public:
+		SpinBenchmark() :
+				Benchmark("Spin benchmark")
+		{
+		}
+
+		void run() override
+		{
+			++calls;
+			auto start = std::chrono::steady_clock::now();
+			while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(100))
+			{
+			}
+		}
+
+		std::size_t calls = 0;
+	};
+
+	class IdleBenchmark : public MereTDD::Benchmark
+	{
+	public:
+		IdleBenchmark() :
+				Benchmark("Idle benchmark")
+		{
+		}
+
+		void run() override
+		{
+		}
+	};
+
+	std::string report(MereTDD::BenchmarkResult const& result)
+	{
+		IdleBenchmark benchmark;
+		benchmark.set_result(result);
+		std::ostringstream output;
+		MereTDD::report_benchmark(output, &benchmark);
+		return output.str();
+	}
+
+	bool contains(std::string const& text, std::string_view part)
+	{
+		return text.find(part) != std::string::npos;
+	}
+}
+
+BENCHMARK("Benchmark string concatenation")
+{
+	std::string text;
+	for (int i = 0; i < 64; ++i)
+	{
+		text += "abc";
+	}
+	MereTDD::do_not_optimize(text);
+}
+
+BENCHMARK("Benchmark int confirms")
+{
+	for (int i = 0; i < 64; ++i)
+	{
+		CONFIRM(i, i);
+	}
+}
+
+TEST("Test CPU lists accept single CPUs and ranges")
+{
+	CONFIRM_TRUE(MereTDD::parse_cpu_list("0,2-3") == std::vector<int>({ 0, 2, 3 }));
+	CONFIRM_TRUE(MereTDD::parse_cpu_list("5") == std::vector<int>({ 5 }));
+	CONFIRM_TRUE(MereTDD::parse_cpu_list("").empty());
+}
+
+TEST("Test CPU lists reject CPUs out of range and backward ranges")
+{
+	CONFIRM_TRUE(MereTDD::parse_cpu_list("0-2000000000").empty());
+	CONFIRM_TRUE(MereTDD::parse_cpu_list("1,4096").empty());
+	CONFIRM_TRUE(MereTDD::parse_cpu_list("3-1").empty());
+}
+
+TEST("Test coefficient of variation")
+{
+	// Mean 5 and standard deviation 2.
+	CONFIRM(0.4, MereTDD::coefficient_of_variation({ 2, 4, 4, 4, 5, 5, 7, 9 }));
+	CONFIRM(0.0, MereTDD::coefficient_of_variation({ 3, 3, 3 }));
+	CONFIRM(0.0, MereTDD::coefficient_of_variation({ 0, 0 }));
+}
+
+TEST("Test benchmark warms up and sizes samples to the iteration time")
+{
+	auto saved = MereTDD::get_run_options();
+	MereTDD::get_run_options() = {};
+	SpinBenchmark benchmark;
+	auto result = MereTDD::measure_benchmark(&benchmark, 3);
+	MereTDD::get_run_options() = saved;
+
+	// One iteration sizes the batch, then every warm-up and measured
+	// sample runs a whole batch.
+	CONFIRM_TRUE(result.warmup_samples >= 5);
+	CONFIRM(3, static_cast<int>(result.samples));
+	CONFIRM_TRUE(result.iterations >= 1 && result.iterations <= 100);
+	CONFIRM_TRUE(benchmark.calls == 1 + result.iterations * (result.warmup_samples + result.samples));
+	CONFIRM_TRUE(result.min_ns >= 100000);
+	CONFIRM_TRUE(result.min_ns <= result.median_ns);
+}
+
+TEST("Test benchmark report warns about drift, frequency changes and throttling")
+{
+	MereTDD::BenchmarkResult steady;
+	steady.samples = 3;
+	steady.iterations = 10;
+	steady.calibration_drift = 0.04;
+	steady.frequency_before_khz = 2000000;
+	steady.frequency_after_khz = 2050000;
+	CONFIRM_FALSE(contains(report(steady), "Warning"));
+
+	auto drifted = steady;
+	drifted.calibration_drift = -0.2;
+	CONFIRM_TRUE(contains(report(drifted), "Warning: calibration loop changed by"));
+
+	auto slowed = steady;
+	slowed.frequency_after_khz = 1800000;
+	CONFIRM_TRUE(contains(report(slowed), "Warning: CPU frequency changed while sampling"));
+
+	auto throttled = steady;
+	throttled.throttle_events = 3;
+	CONFIRM_TRUE(contains(report(throttled), "Warning: CPU was thermally throttled 3 times"));
+}
@@ -0,0 +1,38 @@
+/***************************************************************************************
+    File: tests_checks.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Counting confirms per test
+ **************************************************************************************/
+
+#include "../test.h"
+
+#include <cstdint>
+#include <string>
+
+TEST("Test confirms are counted per test")
+{
+	CONFIRM_TRUE(true);
+	CONFIRM(1, 1);
+	CONFIRM(std::string("abc"), std::string("abc"));
+
+	// The count is read before the last confirm adds itself.
+	std::uint64_t count = MereTDD::get_confirm_count();
+	CONFIRM(std::uint64_t{ 3 }, count);
+}
+
+TEST("Test direct confirm calls are counted once")
+{
+	MereTDD::confirm(std::string("abc"), std::string("abc"), std::source_location::current());
+	MereTDD::confirm(2, 2, std::source_location::current());
+
+	std::uint64_t count = MereTDD::get_confirm_count();
+	CONFIRM(std::uint64_t{ 2 }, count);
+}
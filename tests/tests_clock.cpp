@@ -0,0 +1,95 @@
+/***************************************************************************************
+    File: tests_clock.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Virtual clock for time-dependent code
+ **************************************************************************************/
+
+#include "../test.h"
+#include "../clock.h"
+
+#include <chrono>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// Calls the operation until it succeeds, doubling the wait after each
+// failure. Returns the number of attempts or zero when it gave up.
+template<typename Operation>
+int retry_with_backoff(MereTDD::Clock& clock, Operation operation, int max_attempts)
+{
+	auto delay = std::chrono::duration_cast<MereTDD::Clock::duration>(1s);
+	for (int attempt = 1; attempt <= max_attempts; ++attempt)
+	{
+		if (operation())
+		{
+			return attempt;
+		}
+		clock.sleep_for(delay);
+		delay *= 2;
+	}
+	return 0;
+}
+
+TEST("Test clock starts at zero for every test")
+{
+	CONFIRM_TRUE(clock().now().time_since_epoch() == 0ns);
+	clock().advance(5s);
+	CONFIRM_TRUE(clock().now().time_since_epoch() == 5s);
+}
+
+TEST("Test clock is reset for the next test")
+{
+	CONFIRM_TRUE(clock().now().time_since_epoch() == 0ns);
+	CONFIRM(0, static_cast<int>(clock().pending_timers()));
+}
+
+TEST("Test backoff waits on the virtual clock")
+{
+	int calls = 0;
+	int attempts = retry_with_backoff(clock(), [&]()
+	{
+		return ++calls == 5;
+	}, 10);
+
+	CONFIRM(5, attempts);
+	// 1 + 2 + 4 + 8 seconds of backoff before the fifth attempt.
+	CONFIRM_TRUE(clock().now().time_since_epoch() == 15s);
+}
+
+TEST("Test timers fire in due order")
+{
+	std::vector<int> fired;
+	clock().schedule(30s, [&]()
+	{
+		fired.push_back(30);
+	});
+	clock().schedule(10s, [&]()
+	{
+		fired.push_back(10);
+		clock().schedule(5s, [&]()
+		{
+			fired.push_back(15);
+		});
+	});
+	auto cancelled = clock().schedule(20s, [&]()
+	{
+		fired.push_back(20);
+	});
+	clock().cancel(cancelled);
+
+	clock().advance(12s);
+	CONFIRM(1, static_cast<int>(fired.size()));
+
+	clock().sleep_for(1min);
+	std::vector<int> expected{ 10, 15, 30 };
+	CONFIRM(expected, fired);
+	CONFIRM(0, static_cast<int>(clock().pending_timers()));
+}
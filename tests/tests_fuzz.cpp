@@ -0,0 +1,120 @@
+/***************************************************************************************
+    File: tests_fuzz.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Fuzz tests run over their seed corpus
+ **************************************************************************************/
+
+#include "../test.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parses "key=value" lines. Lines without '=' are ignored and
+// later keys replace earlier ones.
+std::map<std::string, std::string> parse_settings(std::string_view text)
+{
+	std::map<std::string, std::string> settings;
+	while (!text.empty())
+	{
+		auto end = text.find('\n');
+		std::string_view line = text.substr(0, end);
+		text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+		auto equals = line.find('=');
+		if (equals == std::string_view::npos)
+		{
+			continue;
+		}
+		settings[std::string(line.substr(0, equals))] = line.substr(equals + 1);
+	}
+	return settings;
+}
+
+namespace
+{
+	// Keeps every input it is given so a test can see which corpus
+	// was read.
+	class CollectingFuzzTest : public MereTDD::FuzzTest
+	{
+	public:
+		explicit CollectingFuzzTest(std::string_view name) :
+				FuzzTest(name, "")
+		{
+		}
+
+		void run_input(const std::uint8_t* data, std::size_t size) override
+		{
+			inputs.emplace_back(reinterpret_cast<const char*>(data), size);
+		}
+
+		std::vector<std::string> inputs;
+	};
+}
+
+TEST_FUZZ("Test settings parser", const std::uint8_t* data, std::size_t size)
+{
+	std::string_view text(reinterpret_cast<const char*>(data), size);
+	auto settings = parse_settings(text);
+
+	for (auto const& [key, value]: settings)
+	{
+		CONFIRM_TRUE(key.find('\n') == std::string::npos);
+		CONFIRM_TRUE(value.find('\n') == std::string::npos);
+		CONFIRM_TRUE(key.size() + value.size() < size);
+	}
+}
+
+TEST_FUZZ("Test fuzz failure names corpus input", const std::uint8_t* data, std::size_t size)
+{
+	std::string reason = "    Corpus input: ";
+	reason += std::string(location().file_name()).substr(0, std::string(location().file_name()).rfind('/') + 1);
+	reason += "corpus/Test_fuzz_failure_names_corpus_input/empty_value\n";
+	reason += "    Expected: false";
+	set_expected_failure_reason(reason);
+
+	auto settings = parse_settings(std::string_view(reinterpret_cast<const char*>(data), size));
+	for (auto const& [key, value]: settings)
+	{
+		CONFIRM_FALSE(value.empty());
+	}
+}
+
+TEST("Test corpus directory option selects where seeds are read")
+{
+	auto directory = std::filesystem::temp_directory_path() / "meretdd_corpus_dir_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory / "Collected_inputs");
+	std::ofstream(directory / "Collected_inputs" / "a") << "first";
+	std::ofstream(directory / "Collected_inputs" / "b") << "second";
+
+	auto saved = MereTDD::get_run_options();
+	MereTDD::get_run_options() = {};
+	std::string option = "--corpus-dir=" + directory.string();
+	char* argv[] = { const_cast<char*>("Tests"), option.data() };
+	MereTDD::parse_options(2, argv);
+	std::string corpus_dir = MereTDD::get_run_options().corpus_dir;
+
+	CollectingFuzzTest test("Collected inputs");
+	test.run();
+
+	MereTDD::get_run_options() = saved;
+	std::filesystem::remove_all(directory);
+
+	CONFIRM(directory.string(), corpus_dir);
+	CONFIRM(2, static_cast<int>(test.inputs.size()));
+	CONFIRM("first", test.inputs[0]);
+	CONFIRM("second", test.inputs[1]);
+}
@@ -0,0 +1,140 @@
+/***************************************************************************************
+    File: tests_limits.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Resource limits for tests running in isolated child processes
+ **************************************************************************************/
+
+#include "../test.h"
+#include "nested_run.h"
+
+#include <string>
+#include <vector>
+
+#ifdef MERETDD_HAS_POSIX
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class LimitedProcess
+{
+public:
+	void setup()
+	{
+	}
+
+	void teardown()
+	{
+	}
+};
+
+MereTDD::TestSuiteSetupAndTeardown<LimitedProcess> g_limited("Limited process", "Suite limits");
+
+MereTDD::SuiteResourceLimits g_limits("Suite limits", { .address_space = 4ULL << 30 });
+
+TEST_SUITE("Test allocation within address space limit passes", "Suite limits")
+{
+	std::vector<char> buffer(1 << 20, 'a');
+	CONFIRM('a', buffer.back());
+}
+
+TEST_SUITE("Test allocation over address space limit is reported", "Suite limits")
+{
+	set_expected_failure_reason("Resource limit exceeded: address space of 4294967296 bytes.");
+
+	std::vector<char> buffer(8ULL << 30);
+	CONFIRM_TRUE(buffer.empty());
+}
+
+TEST_SUITE("Test can tighten its own limits", "Suite limits")
+{
+	set_expected_failure_reason("Resource limit exceeded: address space of 1073741824 bytes.");
+	limit_resources({ .address_space = 1ULL << 30 });
+
+	std::vector<char> buffer(2ULL << 30);
+	CONFIRM_TRUE(buffer.empty());
+}
+
+#ifdef MERETDD_HAS_POSIX
+TEST("Test CPU time over the limit is reported")
+{
+	LocalTest spinning("Limit CPU spinning test", "", []()
+	{
+		volatile unsigned long long spins = 0;
+		while (true)
+		{
+			spins = spins + 1;
+		}
+	});
+
+	std::string report = run_nested({ "--limit-cpu=1", "--filter=Limit CPU spinning test" });
+
+	CONFIRM_TRUE(contains(report, "Resource limit exceeded: CPU time of 1 seconds."));
+	CONFIRM_TRUE(contains(report, "Tests failed: 1\n"));
+}
+
+TEST("Test open files over the limit are reported")
+{
+	LocalTest opening("Limit files opening test", "", []()
+	{
+		std::vector<int> fds;
+		while (true)
+		{
+			int fd = open("/dev/null", O_RDONLY);
+			if (fd == -1)
+			{
+				throw std::system_error(errno, std::generic_category());
+			}
+			fds.push_back(fd);
+		}
+	});
+
+	std::string report = run_nested({ "--limit-files=16", "--filter=Limit files opening test" });
+
+	CONFIRM_TRUE(contains(report, "Resource limit exceeded: 16 open files."));
+	CONFIRM_TRUE(contains(report, "Tests failed: 1\n"));
+}
+
+TEST("Test isolated test killed by a signal is reported with the signal")
+{
+	LocalTest killed("Isolate killed test", "", []()
+	{
+		std::raise(SIGTERM);
+	});
+
+	std::string report = run_nested({ "--isolate", "--filter=Isolate killed test" });
+
+	CONFIRM_TRUE(contains(report, "Test process terminated by signal " + std::to_string(SIGTERM) + "."));
+	CONFIRM_TRUE(contains(report, "Tests failed: 1\n"));
+}
+
+TEST("Test isolated test that crashes leaves the run going")
+{
+	LocalTest crashing("Isolate crash 1", "", []()
+	{
+		std::abort();
+	});
+	LocalTest passing("Isolate crash 2", "", []()
+	{
+	});
+
+	std::string report = run_nested({ "--isolate", "--filter=Isolate crash" });
+
+	CONFIRM_TRUE(contains(report, "Test process terminated by signal " + std::to_string(SIGABRT) + "."));
+	CONFIRM_TRUE(contains(report, "Test: Isolate crash 2\nPassed"));
+	CONFIRM_TRUE(contains(report, "Tests passed: 1\n"));
+	CONFIRM_TRUE(contains(report, "Tests failed: 1\n"));
+}
+#endif
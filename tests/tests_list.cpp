@@ -0,0 +1,89 @@
+/***************************************************************************************
+    File: tests_list.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Listing registered tests without running them
+ **************************************************************************************/
+
+#include "../test.h"
+
+#include <sstream>
+#include <string>
+
+constexpr int listing_test_line = __LINE__ + 1;
+TEST("Test listing includes test name and location")
+{
+	std::ostringstream output;
+	MereTDD::list_tests(output, MereTDD::ListMode::human);
+	std::string listing = output.str();
+
+	CONFIRM_TRUE(listing.find("  Test listing includes test name and location (") != std::string::npos);
+	CONFIRM_TRUE(listing.find("tests_list.cpp:" + std::to_string(listing_test_line) + ")") != std::string::npos);
+}
+
+TEST_EX("Test listing includes expected exception type", int)
+{
+	std::ostringstream output;
+	MereTDD::list_tests(output, MereTDD::ListMode::human);
+	std::string listing = output.str();
+
+	CONFIRM_TRUE(listing.find("Test listing includes expected exception type [throws int]") != std::string::npos);
+	throw 1;
+}
+
+// The listing tests only rely on suites defined in this file, so the
+// file also passes when built as an executable of its own.
+class ListingFixture
+{
+public:
+	void setup()
+	{
+	}
+
+	void teardown()
+	{
+	}
+};
+
+MereTDD::TestSuiteSetupAndTeardown<ListingFixture> g_listing_fixture("Listing fixture", "Listing suite");
+
+MereTDD::TestSuiteSetupAndTeardown<ListingFixture> g_lonely_fixture("Lonely listing fixture", "Listing suite without tests");
+
+TEST_SUITE_EX("Test listed inside a suite", "Listing suite", int)
+{
+	throw 1;
+}
+
+TEST("Test json listing includes suites and fixtures")
+{
+	std::ostringstream output;
+	MereTDD::list_tests(output, MereTDD::ListMode::json);
+	std::string listing = output.str();
+
+	CONFIRM_TRUE(listing.starts_with("{\"suites\":["));
+	CONFIRM_TRUE(listing.find("{\"name\":\"Listing suite\",\"fixtures\":[{\"name\":\"Listing fixture\"")
+			!= std::string::npos);
+	CONFIRM_TRUE(listing.find("\"name\":\"Test listed inside a suite\",\"exception\":\"int\"") != std::string::npos);
+}
+
+TEST("Test listing includes suites that only have fixtures")
+{
+	std::ostringstream human;
+	MereTDD::list_tests(human, MereTDD::ListMode::human);
+	std::ostringstream json;
+	MereTDD::list_tests(json, MereTDD::ListMode::json);
+
+	CONFIRM_TRUE(human.str().find("Suite: Listing suite without tests\n  Fixture: Lonely listing fixture (")
+			!= std::string::npos);
+	CONFIRM_TRUE(json.str().find("{\"name\":\"Listing suite without tests\",\"fixtures\":[{\"name\":\"Lonely listing fixture\"")
+			!= std::string::npos);
+	auto lonely = json.str().find("Lonely listing fixture");
+	CONFIRM_TRUE(json.str().find("}],\"tests\":[]}", lonely) != std::string::npos);
+}
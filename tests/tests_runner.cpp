@@ -0,0 +1,485 @@
+/***************************************************************************************
+    File: tests_runner.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    The runner driving nested runs of tests created inside a test
+ **************************************************************************************/
+
+#include "../test.h"
+#include "../arena.h"
+#include "../clock.h"
+#include "nested_run.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef MERETDD_HAS_POSIX
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	class CountedFixture
+	{
+	public:
+		void setup()
+		{
+			++setups;
+		}
+
+		void teardown()
+		{
+			++teardowns;
+		}
+
+		int setups = 0;
+		int teardowns = 0;
+	};
+
+	class FlakyFixture
+	{
+	public:
+		void setup()
+		{
+			if (failing)
+			{
+				throw std::runtime_error("setup failed");
+			}
+		}
+
+		void teardown()
+		{
+		}
+
+		bool failing = true;
+	};
+
+	void pass()
+	{
+	}
+
+	void fail()
+	{
+		CONFIRM(1, 2);
+	}
+
+	// Three checks from one call site.
+	void confirm_three_times()
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			CONFIRM(i, i);
+		}
+	}
+
+	// One line of a history file for the given test.
+	std::string history_line(std::string_view outcomes, long average_ns, MereTDD::Test const& test)
+	{
+		return std::string(outcomes) + '\t' + std::to_string(average_ns) + '\t'
+			   + test.location().file_name() + '\t' + std::to_string(test.location().line()) + '\t'
+			   + std::string(test.name()) + '\n';
+	}
+
+	// Polls for a file another process or thread creates.
+	bool wait_for_file(std::filesystem::path const& path)
+	{
+		for (int i = 0; i < 500 && !std::filesystem::exists(path); ++i)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return std::filesystem::exists(path);
+	}
+}
+
+TEST("Test fail-fast stops the run and tears down suites that were set up")
+{
+	MereTDD::TestSuiteSetupAndTeardown<CountedFixture> first("Fail fast fixture 1", "Fail fast suite 1");
+	MereTDD::TestSuiteSetupAndTeardown<CountedFixture> second("Fail fast fixture 2", "Fail fast suite 2");
+	LocalTest failure1("Fail fast failure 1", "Fail fast suite 1", fail);
+	LocalTest failure2("Fail fast failure 2", "Fail fast suite 1", fail);
+	LocalTest skipped1("Fail fast skipped 1", "Fail fast suite 1", pass);
+	LocalTest skipped2("Fail fast skipped 2", "Fail fast suite 2", pass);
+	LocalTest skipped3("Fail fast skipped 3", "Fail fast suite 2", pass);
+
+	std::string report = run_nested({ "--fail-fast=2", "--filter=Fail fast suite" });
+
+	CONFIRM_TRUE(contains(report, "Stopping after 2 failures."));
+	CONFIRM_TRUE(contains(report, "Tests failed: 2\n"));
+	CONFIRM_TRUE(contains(report, "Tests not run: 3\n"));
+	CONFIRM_FALSE(contains(report, "Fail fast skipped"));
+	CONFIRM(1, first.setups);
+	CONFIRM(1, first.teardowns);
+	CONFIRM(0, second.setups);
+	CONFIRM(0, second.teardowns);
+}
+
+TEST("Test history file skips malformed lines and other versions")
+{
+	LocalTest first("History parse 1", "", pass);
+	LocalTest second("History parse 2", "", pass);
+	auto path = temporary_path("meretdd_history_parse");
+
+	std::ofstream(path) << "meretdd-history 2\n"
+						<< history_line("F", 1000, first)
+						<< "P\t5\tno line or name\n"
+						<< history_line("PP", 2000, second);
+	std::string report = run_nested({ "--history=" + path.string(), "--filter=History parse" });
+	CONFIRM_TRUE(contains(report, "Ordered by history of 2 tests"));
+
+	std::ofstream(path) << "meretdd-history 1\n"
+						<< "F\t1000\t\tHistory parse 1\n";
+	report = run_nested({ "--history=" + path.string(), "--filter=History parse" });
+	std::filesystem::remove(path);
+	CONFIRM_TRUE(contains(report, "Ordered by history of 0 tests"));
+}
+
+TEST("Test history runs recent failures first and then the fastest tests")
+{
+	LocalTest slow("History order slow", "", pass);
+	LocalTest fast("History order fast", "", pass);
+	LocalTest failing("History order failing", "", pass);
+	auto path = temporary_path("meretdd_history_order");
+
+	std::ofstream(path) << "meretdd-history 2\n"
+						<< history_line("PPPP", 50000000, slow)
+						<< history_line("PPPP", 1000, fast)
+						<< history_line("FPPP", 50000000, failing);
+	std::string report = run_nested({ "--history=" + path.string(), "--filter=History order" });
+	std::filesystem::remove(path);
+
+	auto failing_at = report.find("Test: History order failing");
+	auto fast_at = report.find("Test: History order fast");
+	auto slow_at = report.find("Test: History order slow");
+	CONFIRM_TRUE(slow_at != std::string::npos);
+	CONFIRM_TRUE(failing_at < fast_at);
+	CONFIRM_TRUE(fast_at < slow_at);
+}
+
+TEST("Test history keeps tests with the same name apart")
+{
+	LocalTest passing("History duplicate", "", pass);
+	LocalTest failing("History duplicate", "", fail);
+	auto path = temporary_path("meretdd_history_duplicate");
+
+	run_nested({ "--history=" + path.string(), "--filter=History duplicate" });
+	std::string history = read_file(path);
+	std::filesystem::remove(path);
+
+	CONFIRM_TRUE(contains(history, "P\t"));
+	CONFIRM_TRUE(contains(history, "F\t"));
+	CONFIRM_TRUE(contains(history, std::to_string(passing.location().line()) + "\tHistory duplicate\n"));
+	CONFIRM_TRUE(contains(history, std::to_string(failing.location().line()) + "\tHistory duplicate\n"));
+}
+
+TEST("Test a fixture whose setup failed passes when set up again")
+{
+	MereTDD::TestSuiteSetupAndTeardown<FlakyFixture> fixture("Flaky fixture", "Flaky suite");
+	LocalTest first("Flaky suite test 1", "Flaky suite", pass);
+	LocalTest second("Flaky suite test 2", "Flaky suite", pass);
+
+	std::string report = run_nested({ "--filter=Flaky suite" });
+	CONFIRM_TRUE(contains(report, "Test suite setup failed."));
+	CONFIRM_TRUE(contains(report, "Tests not run: 2\n"));
+
+	fixture.failing = false;
+	report = run_nested({ "--filter=Flaky suite" });
+	CONFIRM_FALSE(contains(report, "Test suite setup failed."));
+	CONFIRM_TRUE(contains(report, "Tests failed: 0\n"));
+}
+
+TEST("Test a suite without a fixture stops the run after tearing down and summing up")
+{
+	MereTDD::TestSuiteSetupAndTeardown<CountedFixture> shared("Missing run fixture", { "Missing run suite A", "Missing run suite C" });
+	LocalTest first("Missing run test A", "Missing run suite A", pass);
+	LocalTest missing("Missing run test B", "Missing run suite B", pass);
+	LocalTest last("Missing run test C", "Missing run suite C", pass);
+	auto summary_path = temporary_path("meretdd_missing_suite_summary");
+
+	std::string report = run_nested({ "--filter=Missing run", "--summary=" + summary_path.string() });
+
+	CONFIRM_TRUE(contains(report, "Test suite is not found."));
+	CONFIRM_FALSE(contains(report, "Test: Missing run test C"));
+	CONFIRM_TRUE(contains(report, "Tests not run: 2\n"));
+	CONFIRM(1, shared.setups);
+	CONFIRM(1, shared.teardowns);
+
+	MereTDD::RunSummary summary;
+	CONFIRM_TRUE(MereTDD::read_summary(summary_path.string(), summary));
+	std::filesystem::remove(summary_path);
+	CONFIRM(1, summary.failed);
+	CONFIRM(2, static_cast<int>(summary.not_run));
+}
+
+TEST("Test filter leaves fixtures of unselected suites alone")
+{
+	MereTDD::TestSuiteSetupAndTeardown<CountedFixture> selected("Chosen fixture", "Chosen suite");
+	MereTDD::TestSuiteSetupAndTeardown<CountedFixture> unselected("Passed over fixture", "Passed over suite");
+	LocalTest chosen("Chosen suite test", "Chosen suite", pass);
+	LocalTest passed_over("Passed over suite test", "Passed over suite", pass);
+
+	std::string report = run_nested({ "--filter=Chosen suite" });
+
+	CONFIRM_TRUE(contains(report, "Tests passed: 3\n"));
+	CONFIRM(1, selected.setups);
+	CONFIRM(1, selected.teardowns);
+	CONFIRM(0, unselected.setups);
+	CONFIRM(0, unselected.teardowns);
+	CONFIRM_FALSE(contains(report, "Passed over fixture"));
+}
+
+TEST("Test a shared fixture is set up once and torn down after its last test")
+{
+	MereTDD::TestSuiteSetupAndTeardown<CountedFixture> shared("Shared fixture", { "Sharing suite A", "Sharing suite B" });
+	LocalTest a1("Sharing test A1", "Sharing suite A", pass);
+	LocalTest a2("Sharing test A2", "Sharing suite A", pass);
+	LocalTest b1("Sharing test B1", "Sharing suite B", pass);
+	LocalTest b2("Sharing test B2", "Sharing suite B", pass);
+
+	std::string report = run_nested({ "--filter=Sharing suite" });
+
+	CONFIRM(1, shared.setups);
+	CONFIRM(1, shared.teardowns);
+	auto setup_at = report.find("Setup: Shared fixture");
+	auto teardown_at = report.find("Teardown: Shared fixture");
+	CONFIRM_TRUE(setup_at < report.find("Test: Sharing test A1"));
+	CONFIRM_TRUE(teardown_at != std::string::npos);
+	CONFIRM_TRUE(teardown_at > report.find("Test: Sharing test B2"));
+	CONFIRM_TRUE(teardown_at > report.find("Test: Sharing test A2"));
+}
+
+TEST("Test checks option reports confirms per test and for the run")
+{
+	LocalTest counted("Counted checks", "", confirm_three_times);
+
+	std::string report = run_nested({ "--checks", "--filter=Counted checks" });
+
+	CONFIRM_TRUE(contains(report, "    Checks: 3 ("));
+	CONFIRM_TRUE(contains(report, "\nChecks: 3 in "));
+	CONFIRM_FALSE(contains(report, "Confirm profile"));
+}
+
+TEST("Test confirm profile reports the hot confirm sites")
+{
+	LocalTest profiled("Profiled checks", "", confirm_three_times);
+
+	std::string report = run_nested({ "--confirm-profile", "--filter=Profiled checks" });
+
+	CONFIRM_TRUE(contains(report, "\nChecks: 3 in "));
+	CONFIRM_TRUE(contains(report, "Confirm profile, top 1 sites by time:\n"));
+	CONFIRM_TRUE(contains(report, std::string("3 checks, ") + __FILE__ + ":"));
+}
+
+TEST("Test a nested run leaves the arena, clock and confirms of its test alone")
+{
+	using namespace std::chrono_literals;
+
+	std::pmr::string kept("memory the outer test still holds after the nested run", arena());
+	clock().advance(5s);
+	CONFIRM_TRUE(true);
+	auto confirms = MereTDD::get_confirm_count();
+
+	LocalTest nested("Nested state test", "", []()
+	{
+		std::pmr::string overwrite(200, 'x', &MereTDD::get_test_arena());
+		MereTDD::get_test_clock().advance(1s);
+		CONFIRM(200, static_cast<int>(overwrite.size()));
+	});
+	std::string report = run_nested({ "--filter=Nested state test" });
+
+	std::pmr::string after(200, 'y', arena());
+
+	CONFIRM_TRUE(contains(report, "Tests passed: 1\n"));
+	CONFIRM("memory the outer test still holds after the nested run", std::string(kept));
+	CONFIRM_TRUE(clock().now().time_since_epoch() == 5s);
+	CONFIRM(static_cast<int>(confirms) + 3, static_cast<int>(MereTDD::get_confirm_count()));
+}
+
+TEST("Test perf counters option reports counts or says they are unavailable")
+{
+	LocalTest counted("Perf counted test", "", confirm_three_times);
+
+	std::string report = run_nested({ "--perf-counters", "--filter=Perf counted test" });
+
+	CONFIRM_TRUE(contains(report, "Tests passed: 1\n"));
+	if (contains(report, "Performance counters unavailable.\n"))
+	{
+		CONFIRM_FALSE(contains(report, "    Counters:"));
+	}
+	else
+	{
+		CONFIRM_TRUE(contains(report, "Performance counters: "));
+		CONFIRM_TRUE(contains(report, "    Counters: "));
+	}
+}
+
+#ifdef MERETDD_HAS_POSIX
+TEST("Test workers count tests of a suite whose setup failed as not run")
+{
+	MereTDD::TestSuiteSetupAndTeardown<FlakyFixture> fixture("Flaky worker fixture", "Flaky worker suite");
+	LocalTest first("Flaky worker test 1", "Flaky worker suite", pass);
+	LocalTest second("Flaky worker test 2", "Flaky worker suite", pass);
+
+	std::string report = run_nested({ "--workers=1", "--filter=Flaky worker suite" });
+
+	CONFIRM_TRUE(contains(report, "Test suite setup failed."));
+	CONFIRM_TRUE(contains(report, "Tests not run: 2\n"));
+}
+
+TEST("Test workers run each selected test once and merge the summary")
+{
+	auto directory = temporary_path("meretdd_workers_distribute");
+	std::filesystem::create_directories(directory);
+	auto record_pid = [directory](std::string name)
+	{
+		return [directory, name]()
+		{
+			std::ofstream(directory / name, std::ios::app) << getpid() << '\n';
+		};
+	};
+	LocalTest first("Spread test 1", "", record_pid("1"));
+	LocalTest second("Spread test 2", "", record_pid("2"));
+	LocalTest third("Spread test 3", "", record_pid("3"));
+	LocalTest failure("Spread test failure", "", fail);
+
+	auto summary_path = directory / "summary";
+	std::string report = run_nested({ "--workers=2", "--filter=Spread test", "--summary=" + summary_path.string() });
+	MereTDD::RunSummary summary;
+	bool summary_read = MereTDD::read_summary(summary_path.string(), summary);
+	std::string pids[] = { read_file(directory / "1"), read_file(directory / "2"), read_file(directory / "3") };
+	std::filesystem::remove_all(directory);
+
+	CONFIRM_TRUE(contains(report, "on 2 workers"));
+	CONFIRM_TRUE(contains(report, "Tests passed: 3\n"));
+	CONFIRM_TRUE(contains(report, "Tests failed: 1\n"));
+	CONFIRM_TRUE(summary_read);
+	CONFIRM(3, summary.passed);
+	CONFIRM(1, summary.failed);
+	for (auto const& pid: pids)
+	{
+		// One line means the test ran once, and in a worker.
+		CONFIRM_TRUE(!pid.empty() && pid.find('\n') == pid.size() - 1);
+		CONFIRM_TRUE(std::atol(pid.c_str()) != getpid());
+	}
+}
+
+TEST("Test a test that brings its worker down is retried up to the limit")
+{
+	LocalTest crash("Worker crash", "", []()
+	{
+		std::_Exit(1);
+	});
+
+	std::string report = run_nested({ "--workers=1", "--filter=Worker crash" });
+
+	CONFIRM_TRUE(contains(report, "Worker process stopped while running the test 3 times."));
+	CONFIRM_TRUE(contains(report, "Tests retried: 2\n"));
+	CONFIRM_TRUE(contains(report, "Tests failed: 1\n"));
+}
+
+TEST("Test fail-fast cancels tests already running on workers")
+{
+	auto marker = temporary_path("meretdd_workers_cancelled");
+	LocalTest waiting("Cancel on worker wait", "", [marker]()
+	{
+		auto start = std::chrono::steady_clock::now();
+		while (!MereTDD::get_cancellation_token().cancelled()
+			   && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		if (MereTDD::get_cancellation_token().cancelled())
+		{
+			std::ofstream(marker) << "cancelled";
+		}
+	});
+	LocalTest failure("Cancel on worker failure", "", []()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		fail();
+	});
+
+	std::string report = run_nested({ "--workers=2", "--fail-fast", "--filter=Cancel on worker" });
+	bool cancelled = std::filesystem::exists(marker);
+	std::filesystem::remove(marker);
+
+	CONFIRM_TRUE(contains(report, "Stopping after 1 failure."));
+	CONFIRM_TRUE(cancelled);
+}
+
+TEST("Test a client that never says hello does not hold the run open")
+{
+	auto directory = temporary_path("meretdd_workers_silent");
+	std::filesystem::create_directories(directory);
+	auto socket_path = directory / "socket";
+	auto marker = directory / "connected";
+	std::atomic<bool> run_over{ false };
+
+	std::thread client([&]()
+	{
+		int fd = -1;
+		for (int i = 0; i < 500 && fd < 0 && !run_over; ++i)
+		{
+			fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+			if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+			{
+				close(fd);
+				fd = -1;
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+		if (fd < 0)
+		{
+			return;
+		}
+		std::ofstream(marker) << "connected";
+		while (!run_over)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		close(fd);
+	});
+
+	// Keeps the run going until the silent client is connected.
+	LocalTest waiting("Silent client wait", "", [marker]()
+	{
+		wait_for_file(marker);
+	});
+
+	auto start = std::chrono::steady_clock::now();
+	std::string report = run_nested({ "--workers=1", "--listen=unix:" + socket_path.string(),
+			"--filter=Silent client wait" });
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	run_over = true;
+	client.join();
+	bool connected = std::filesystem::exists(marker);
+	std::filesystem::remove_all(directory);
+
+	CONFIRM_TRUE(connected);
+	CONFIRM_TRUE(contains(report, "Tests passed: 1\n"));
+	CONFIRM_TRUE(elapsed < std::chrono::seconds(5));
+}
+#endif
@@ -13,7 +13,9 @@
  **************************************************************************************/
 
 #include "../test.h"
+#include "nested_run.h"
 
+#include <string>
 #include <string_view>
 
 std::string create_test_table()
@@ -156,6 +158,133 @@ TEST_SUITE_EX("Test part 2 of suite", "Suite 1", int)
 	throw 1;
 }
 
+class CountedConnection
+{
+public:
+	void setup()
+	{
+		++setups;
+		connected = true;
+	}
+
+	void teardown()
+	{
+		connected = false;
+	}
+
+	static inline int setups = 0;
+	static inline bool connected = false;
+};
+
+// One fixture for two suites is set up before the first of their
+// tests and stays up until the last of them has run.
+MereTDD::TestSuiteSetupAndTeardown<CountedConnection> g_shared_connection("Shared connection",
+		{ "Shared suite A", "Shared suite B" });
+
+TEST_SUITE("Test shared fixture is set up for the first suite", "Shared suite A")
+{
+	CONFIRM_TRUE(CountedConnection::connected);
+	CONFIRM(1, CountedConnection::setups);
+}
+
+TEST_SUITE("Test shared fixture is still up for the second suite", "Shared suite B")
+{
+	CONFIRM_TRUE(CountedConnection::connected);
+	CONFIRM(1, CountedConnection::setups);
+}
 
+class LeakyEntry
+{
+public:
+	void setup()
+	{
+		m_buffer = new char[4096];
+	}
 
+	void teardown()
+	{
+		// Deliberately does not release the buffer.
+	}
+
+	char* buffer() const
+	{
+		return m_buffer;
+	}
+
+private:
+	char* m_buffer{};
+};
+
+#ifdef MERETDD_HAS_MALLINFO2
+TEST("Test fixture that leaks heap memory is flagged")
+{
+	auto& options = MereTDD::get_run_options();
+	bool memory_usage = options.memory_usage;
+	options.memory_usage = true;
+	std::int64_t leaked_before = MereTDD::get_fixture_leaked_bytes();
 
+	char* buffer = nullptr;
+	{
+		MereTDD::SetupAndTeardown<LeakyEntry> entry;
+		buffer = entry.buffer();
+	}
+	std::int64_t leaked = MereTDD::get_fixture_leaked_bytes() - leaked_before;
+
+	// Clean up so the runner does not report this
+	// deliberate leak against the test itself.
+	delete[] buffer;
+	MereTDD::get_fixture_leaked_bytes() = leaked_before;
+	options.memory_usage = memory_usage;
+
+	CONFIRM_TRUE(leaked >= 4096);
+}
+
+class LeakySuite
+{
+public:
+	void setup()
+	{
+		m_buffer = new char[4096];
+	}
+
+	void teardown()
+	{
+		// Deliberately does not release the buffer.
+	}
+
+	char* buffer() const
+	{
+		return m_buffer;
+	}
+
+private:
+	char* m_buffer{};
+};
+
+TEST("Test memory usage option reports the memory of each test")
+{
+	LocalTest measured("Measured memory test", "", []()
+	{
+	});
+
+	std::string report = run_nested({ "--memory-usage", "--filter=Measured memory test" });
+
+	CONFIRM_TRUE(contains(report, "Test: Measured memory test\nPassed\n    Memory: rss "));
+	CONFIRM_TRUE(contains(report, " bytes, peak "));
+	CONFIRM_FALSE(contains(report, "    Leaked "));
+}
+
+TEST("Test suite fixture that leaks heap memory is flagged")
+{
+	MereTDD::TestSuiteSetupAndTeardown<LeakySuite> fixture("Leaky suite fixture", "Leaky suite");
+	LocalTest test("Leaky suite test", "Leaky suite", []()
+	{
+	});
+
+	std::string report = run_nested({ "--memory-usage", "--filter=Leaky suite" });
+	delete[] fixture.buffer();
+
+	CONFIRM_TRUE(contains(report, "Tests passed: 3\n"));
+	CONFIRM_TRUE(contains(report, " heap bytes across TestSuiteSetupAndTeardown\n"));
+}
+#endif
@@ -0,0 +1,124 @@
+/***************************************************************************************
+    File: tests_snapshot.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Snapshot (golden file) confirms
+ **************************************************************************************/
+
+#include "../test.h"
+#include "nested_run.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+std::string format_report(std::vector<std::pair<std::string, int>> const& values)
+{
+	std::string report = "Report\n======\n";
+	for (auto const& [name, value]: values)
+	{
+		report += name + ": " + std::to_string(value) + '\n';
+	}
+	return report;
+}
+
+std::vector<std::pair<std::string, int>> report_values()
+{
+	return {
+			{ "alpha",   1 },
+			{ "beta",    2 },
+			{ "gamma",   3 },
+			{ "delta",   4 },
+			{ "epsilon", 5 },
+			{ "zeta",    6 },
+			{ "eta",     7 },
+			{ "theta",   8 },
+	};
+}
+
+TEST("Test snapshot confirms")
+{
+	CONFIRM_SNAPSHOT("report", format_report(report_values()));
+}
+
+TEST("Test snapshot confirm failure shows only changed lines")
+{
+	std::string reason = "    Snapshot report differs from ";
+	reason += std::string(location().file_name()).substr(0, std::string(location().file_name()).rfind('/') + 1);
+	reason += "snapshots/report.snap\n";
+	reason += "    Expected 84 bytes, actual 85 bytes, first difference at byte 48\n";
+	reason += "    @@ -3,7 +3,7 @@\n";
+	reason += "     alpha: 1\n";
+	reason += "     beta: 2\n";
+	reason += "     gamma: 3\n";
+	reason += "    -delta: 4\n";
+	reason += "    +delta: 40\n";
+	reason += "     epsilon: 5\n";
+	reason += "     zeta: 6\n";
+	reason += "     eta: 7";
+	set_expected_failure_reason(reason);
+
+	auto values = report_values();
+	values[3].second = 40;
+	CONFIRM_SNAPSHOT("report", format_report(values));
+}
+
+TEST("Test snapshot confirm failure for missing golden file")
+{
+	std::string reason = "    Snapshot file ";
+	reason += std::string(location().file_name()).substr(0, std::string(location().file_name()).rfind('/') + 1);
+	reason += "snapshots/missing.snap does not exist.\n";
+	reason += "    Run with --update-snapshots to create it.";
+	set_expected_failure_reason(reason);
+
+	CONFIRM_SNAPSHOT("missing", "anything");
+}
+
+TEST("Test update snapshots writes goldens to the snapshot directory")
+{
+	auto directory = temporary_path("meretdd_snapshot_update");
+	LocalTest test("Snapshot update", "", []()
+	{
+		CONFIRM_SNAPSHOT("created", "created text\n");
+	});
+
+	std::string updated = run_nested({ "--update-snapshots", "--snapshot-dir=" + directory.string(),
+			"--filter=Snapshot update" });
+	std::string golden = read_file(directory / "created.snap");
+	std::string compared = run_nested({ "--snapshot-dir=" + directory.string(), "--filter=Snapshot update" });
+	std::filesystem::remove_all(directory);
+
+	CONFIRM_TRUE(contains(updated, "Tests passed: 1\n"));
+	CONFIRM("created text\n", golden);
+	CONFIRM_TRUE(contains(compared, "Tests passed: 1\n"));
+}
+
+TEST("Test update snapshots leaves goldens of tests expecting failure alone")
+{
+	auto directory = temporary_path("meretdd_snapshot_expected_failure");
+	std::filesystem::create_directories(directory);
+	std::ofstream(directory / "kept.snap") << "golden text\n";
+	LocalTest test("Snapshot expected failure", "", [&test]()
+	{
+		test.set_expected_failure_reason("a mismatch");
+		CONFIRM_SNAPSHOT("kept", "changed text\n");
+		CONFIRM_SNAPSHOT("absent", "any text\n");
+	});
+
+	run_nested({ "--update-snapshots", "--snapshot-dir=" + directory.string(),
+			"--filter=Snapshot expected failure" });
+	std::string golden = read_file(directory / "kept.snap");
+	bool absent_created = std::filesystem::exists(directory / "absent.snap");
+	std::filesystem::remove_all(directory);
+
+	CONFIRM("golden text\n", golden);
+	CONFIRM_FALSE(absent_created);
+}
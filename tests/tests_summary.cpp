@@ -0,0 +1,62 @@
+/***************************************************************************************
+    File: tests_summary.cpp
+    Author: Navid Dezashibi
+    Initial Creation Date: 2023-05-23
+    Contact: navid@dezashibi.com
+    Website: https://dezashibi.com
+    License:
+    Please refer to the LICENSE file, repository or website for more information about
+    the licensing of this work. If you have any questions or concerns,
+    please feel free to contact me at the email address provided above.
+ ***************************************************************************************
+    Run summaries written for the test driver
+ **************************************************************************************/
+
+#include "../test.h"
+#include "nested_run.h"
+
+#include <fstream>
+
+TEST("Test summary file reads back what was written")
+{
+	auto path = temporary_path("meretdd_summary_round_trip");
+	MereTDD::RunSummary written{ 7, 3, 1, 2, 4 };
+	CONFIRM_TRUE(MereTDD::write_summary(path.string(), written));
+
+	MereTDD::RunSummary read;
+	CONFIRM_TRUE(MereTDD::read_summary(path.string(), read));
+	CONFIRM(7, read.passed);
+	CONFIRM(3, read.failed);
+	CONFIRM(1, read.missed_failed);
+	CONFIRM(2, read.over_limit);
+	CONFIRM(4, static_cast<int>(read.not_run));
+}
+
+TEST("Test summary file that is missing is not read")
+{
+	auto path = temporary_path("meretdd_summary_missing");
+	MereTDD::RunSummary read;
+	CONFIRM_FALSE(MereTDD::read_summary(path.string(), read));
+}
+
+TEST("Test summary file cut short is not read")
+{
+	auto path = temporary_path("meretdd_summary_truncated");
+	{
+		std::ofstream file(path);
+		file << "passed 7\nfailed 3\n";
+	}
+	MereTDD::RunSummary read;
+	CONFIRM_FALSE(MereTDD::read_summary(path.string(), read));
+}
+
+TEST("Test summary file with a malformed value is not read")
+{
+	auto path = temporary_path("meretdd_summary_malformed");
+	{
+		std::ofstream file(path);
+		file << "passed x\nfailed 3\nmissed_failed 1\nover_limit 2\nnot_run 4\n";
+	}
+	MereTDD::RunSummary read;
+	CONFIRM_FALSE(MereTDD::read_summary(path.string(), read));
+}